@@ -2,8 +2,17 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "../../common/codec_core.hpp"
+
+// 输入文件的只读视图（mmap），与其他编解码工具共用 common/codec_core.hpp
+// 中的实现；mmap 不可用或失败时调用方退回到逐字节流式读取。
+using codec_core::MappedFile;
 
 // 简单的 Run-Length 编码实现。
 // 编码格式：重复写入 (count, value) 对，直到文件结束。
@@ -11,13 +20,15 @@
 // - value: 1 字节，表示要重复输出的字节值。
 // 这种格式非常简单，三种语言的实现保持完全一致，便于交叉解码和基准测试。
 
-static void write_u32_le(std::ostream& out, uint32_t v) {
-    unsigned char buf[4];
-    buf[0] = static_cast<unsigned char>(v & 0xFFu);
-    buf[1] = static_cast<unsigned char>((v >> 8) & 0xFFu);
-    buf[2] = static_cast<unsigned char>((v >> 16) & 0xFFu);
-    buf[3] = static_cast<unsigned char>((v >> 24) & 0xFFu);
-    out.write(reinterpret_cast<const char*>(buf), 4);
+// 可选的 --stats 统计：开启后编码/解码各阶段把耗时与段计数记入此处，
+// main() 以单行 key=value 的形式输出到标准错误，便于脚本解析。
+static bool g_stats_enabled = false;
+static std::ostringstream g_stats;
+
+static void stats_add(const char* key, double value) {
+    if (g_stats_enabled) {
+        g_stats << ' ' << key << '=' << value;
+    }
 }
 
 // 从流中读取一个 32 位小端无符号整数。
@@ -47,80 +58,563 @@ static bool read_u32_le(std::istream& in, uint32_t& out_value) {
 }
 
 static bool rle_encode_file_checked(const std::string& inputPath, const std::string& outputPath);
-static bool rle_decode_file_checked(const std::string& inputPath, const std::string& outputPath);
+static bool rle_decode_file_checked(const std::string& inputPath, const std::string& outputPath,
+                                    std::size_t bufferSize = 0, bool sparse = false);
 
 void rle_encode_file(const std::string& inputPath, const std::string& outputPath) {
     (void)rle_encode_file_checked(inputPath, outputPath);
 }
 
-// 对整个文件进行 Run-Length 编码。
-// inputPath  为原始二进制文件路径。
-// outputPath 为编码后文件路径。
-static bool rle_encode_file_checked(const std::string& inputPath, const std::string& outputPath) {
+// 在 [data, data + limit) 区间内查找与 data[0] 相同的前缀长度（run 长度）。
+// 一次按 8 字节字（word）比较：把 run 字节广播到整个字后与内存中的字做
+// 异或，结果为 0 表示 8 个字节全部相同；非 0 时最低的非零字节就是 run
+// 的边界，用 count-trailing-zeros 直接定位，避免逐字节比较。
+static size_t rle_find_run(const uint8_t* data, size_t limit) {
+    const uint8_t value = data[0];
+    const uint64_t pattern = 0x0101010101010101ULL * value;
+    size_t runLen = 1;
+    while (runLen + 8 <= limit) {
+        uint64_t word;
+        std::memcpy(&word, data + runLen, 8);
+        uint64_t diff = word ^ pattern;
+        if (diff != 0) {
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+            // 小端序下字的低字节对应低地址，trailing zeros 即边界偏移。
+            return runLen + (static_cast<size_t>(__builtin_ctzll(diff)) >> 3);
+#else
+            while (data[runLen] == value) {
+                ++runLen;
+            }
+            return runLen;
+#endif
+        }
+        runLen += 8;
+    }
+    while (runLen < limit && data[runLen] == value) {
+        ++runLen;
+    }
+    return runLen;
+}
+
+// 对一段内存数据进行 Run-Length 编码，结果追加到 out 缓冲区。
+// 纯内存入口（span 进、vector 出，全程不经过 iostream），供把本编解码器
+// 内嵌到服务里的调用方直接使用；文件编码入口是它的薄封装。
+void rle_encode_data(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    double t0 = codec_core::now_ms();
+    uint64_t runs = 0;
+    size_t i = 0;
+    while (i < size) {
+        uint8_t value = data[i];
+        size_t limit = std::min<size_t>(size - i, 0xFFFFFFFFu);
+        size_t runLen = rle_find_run(data + i, limit);
+        codec_core::write_u32_le(out, static_cast<uint32_t>(runLen));
+        out.push_back(value);
+        i += runLen;
+        runs++;
+    }
+    if (g_stats_enabled) {
+        stats_add("encode_ms", codec_core::now_ms() - t0);
+        stats_add("runs", static_cast<double>(runs));
+    }
+}
+
+// 解码输出层：持有一块可复用的大缓冲区（默认 4 MiB，可由命令行覆盖），
+// 连续的 run 先在缓冲区内累积，写满后一次性下盘。长 run 的快速路径只
+// memset 一次缓冲区，然后反复写出同一块内存；在 POSIX 平台上直接用
+// write(2) 绕过 iostream 缓冲，避免整缓冲区刷写时的二次拷贝。
+class DecodeSink {
+public:
+    static const std::size_t DEFAULT_BUFFER_SIZE = 1u << 22;
+
+    // 稀疏模式下长度达到此阈值的零 run 直接打洞（lseek 跳过），不再
+    // 物化写出；短零 run 走普通缓冲路径，避免碎洞。
+    static const uint64_t SPARSE_MIN_HOLE = 1u << 16;
+
+    DecodeSink(const std::string& path, std::size_t bufferSize, bool sparse = false)
+        : buf_(bufferSize > 0 ? bufferSize : DEFAULT_BUFFER_SIZE), used_(0), ok_(true),
+          sparse_(sparse), logicalPos_(0), holed_(false), holes_(0), holeBytes_(0) {
+#ifdef CODEC_HAVE_MMAP
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            ok_ = false;
+        }
+#else
+        out_.open(path, std::ios::binary);
+        if (!out_) {
+            ok_ = false;
+        }
+#endif
+        if (!ok_) {
+            std::cerr << "无法打开输出文件用于写入: " << path << "\n";
+        }
+    }
+
+    ~DecodeSink() {
+#ifdef CODEC_HAVE_MMAP
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+#endif
+    }
+
+    DecodeSink(const DecodeSink&) = delete;
+    DecodeSink& operator=(const DecodeSink&) = delete;
+
+    bool ok() const { return ok_; }
+
+    // 输出 count 个 value 字节。缓冲区为空且 run 覆盖整个缓冲区时，
+    // 只做一次 memset，随后重复写出同一块缓冲区。
+    // 稀疏模式下足够长的零 run 不写任何字节：刷掉已缓冲的数据后直接
+    // lseek 跳过 count 字节，让文件系统以空洞表示这段零；还原一个几乎
+    // 全空的磁盘镜像就只剩元数据操作。
+    bool fill(uint8_t value, uint64_t count) {
+#ifdef CODEC_HAVE_MMAP
+        if (sparse_ && value == 0 && count >= SPARSE_MIN_HOLE) {
+            if (used_ > 0 && !flush_buffer()) {
+                return false;
+            }
+            if (::lseek(fd_, static_cast<off_t>(count), SEEK_CUR) < 0) {
+                std::cerr << "写入解码数据失败\n";
+                ok_ = false;
+                return false;
+            }
+            logicalPos_ += count;
+            holed_ = true;
+            holes_++;
+            holeBytes_ += count;
+            return true;
+        }
+#endif
+        if (used_ == 0 && count >= buf_.size()) {
+            std::memset(buf_.data(), value, buf_.size());
+            while (count >= buf_.size()) {
+                if (!raw_write(buf_.data(), buf_.size())) {
+                    return false;
+                }
+                count -= buf_.size();
+            }
+            // 缓冲区已整块填充为 value，余量直接留在缓冲区内。
+            used_ = static_cast<std::size_t>(count);
+            return true;
+        }
+        while (count > 0) {
+            std::size_t chunk = static_cast<std::size_t>(
+                std::min<uint64_t>(count, buf_.size() - used_));
+            std::memset(buf_.data() + used_, value, chunk);
+            used_ += chunk;
+            count -= chunk;
+            if (used_ == buf_.size() && !flush_buffer()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 输出一段原始字节（v2 literal 段）。
+    bool append(const char* data, std::size_t size) {
+        if (used_ == 0 && size >= buf_.size()) {
+            return raw_write(data, size);
+        }
+        while (size > 0) {
+            std::size_t chunk = std::min(size, buf_.size() - used_);
+            std::memcpy(buf_.data() + used_, data, chunk);
+            used_ += chunk;
+            data += chunk;
+            size -= chunk;
+            if (used_ == buf_.size() && !flush_buffer()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 写出缓冲区中剩余的数据。解码结束时必须调用。
+    // 打过洞的文件若以空洞结尾，写指针之后没有任何实际写入，文件大小
+    // 停留在最后一次 write 的位置，需要 ftruncate 把逻辑长度补齐。
+    bool finish() {
+        if (used_ > 0 && !flush_buffer()) {
+            return false;
+        }
+#ifdef CODEC_HAVE_MMAP
+        if (holed_) {
+            if (::ftruncate(fd_, static_cast<off_t>(logicalPos_)) != 0) {
+                std::cerr << "写入解码数据失败\n";
+                ok_ = false;
+                return false;
+            }
+            if (g_stats_enabled) {
+                stats_add("holes", static_cast<double>(holes_));
+                stats_add("hole_bytes", static_cast<double>(holeBytes_));
+            }
+        }
+#endif
+        return true;
+    }
+
+private:
+    bool flush_buffer() {
+        std::size_t n = used_;
+        used_ = 0;
+        return raw_write(buf_.data(), n);
+    }
+
+    bool raw_write(const char* data, std::size_t size) {
+#ifdef CODEC_HAVE_MMAP
+        logicalPos_ += size;
+        while (size > 0) {
+            ssize_t n = ::write(fd_, data, size);
+            if (n < 0) {
+                std::cerr << "写入解码数据失败\n";
+                ok_ = false;
+                return false;
+            }
+            data += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+#else
+        out_.write(data, static_cast<std::streamsize>(size));
+        if (!out_) {
+            std::cerr << "写入解码数据失败\n";
+            ok_ = false;
+            return false;
+        }
+        return true;
+#endif
+    }
+
+#ifdef CODEC_HAVE_MMAP
+    int fd_;
+#else
+    std::ofstream out_;
+#endif
+    std::vector<char> buf_;
+    std::size_t used_;
+    bool ok_;
+    bool sparse_;
+    uint64_t logicalPos_;
+    bool holed_;
+    uint64_t holes_;
+    uint64_t holeBytes_;
+};
+
+// ---------------------------------------------------------------------------
+// v2 格式（混合 RLE）：
+// 以 "RLE2" 魔数开头，其后是若干段（segment）。每段以一个 varint 编码的
+// token 开始：token = (length << 1) | flag。
+// - flag = 1：run 段，后跟 1 个 value 字节，表示 value 重复 length 次。
+// - flag = 0：literal 段，后跟 length 个原始字节，解码时整块拷贝。
+// varint 采用 LEB128（每字节低 7 位有效，最高位为续位标志，小端分组）。
+// 短 run（< 3 字节）并入 literal 段，避免 v1 格式在低冗余输入上
+// 每个字节都付出 5 字节开销导致的最坏 5 倍膨胀。
+// ---------------------------------------------------------------------------
+
+static const size_t RLE2_MIN_RUN = 3;
+
+// 读取一个 varint。返回值：
+//   true  - 成功读取，并写入到 out_value
+//   false - 正常 EOF（第一个字节就没有读到）
+// 截断或超长（超过 10 字节）时输出错误信息并置 badbit。
+static bool read_varint(std::istream& in, uint64_t& out_value) {
+    uint64_t value = 0;
+    int shift = 0;
+    for (int i = 0; i < 10; i++) {
+        int c = in.get();
+        if (c == EOF) {
+            if (i == 0 && !in.bad()) {
+                return false;
+            }
+            std::cerr << "RLE 数据截断：varint 不完整\n";
+            in.setstate(std::ios::badbit);
+            return false;
+        }
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            out_value = value;
+            return true;
+        }
+        shift += 7;
+    }
+    std::cerr << "RLE 数据非法：varint 超长\n";
+    in.setstate(std::ios::badbit);
+    return false;
+}
+
+// 对一段内存数据进行 v2 混合编码，结果追加到 out 缓冲区（纯内存入口，
+// 与 rle_encode_data 同理）。
+void rle2_encode_data(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    double t0 = codec_core::now_ms();
+    uint64_t runSegments = 0;
+    uint64_t literalSegments = 0;
+    const char magic[4] = {'R', 'L', 'E', '2'};
+    out.insert(out.end(), magic, magic + 4);
+
+    auto emit_literal = [&](size_t start, size_t end) {
+        size_t length = end - start;
+        codec_core::write_varint(out, static_cast<uint64_t>(length) << 1);
+        out.insert(out.end(), data + start, data + end);
+        literalSegments++;
+    };
+
+    size_t i = 0;
+    size_t litStart = 0;
+    while (i < size) {
+        size_t runLen = rle_find_run(data + i, size - i);
+        if (runLen >= RLE2_MIN_RUN) {
+            if (litStart < i) {
+                emit_literal(litStart, i);
+            }
+            codec_core::write_varint(out, (static_cast<uint64_t>(runLen) << 1) | 1);
+            out.push_back(data[i]);
+            i += runLen;
+            litStart = i;
+            runSegments++;
+        } else {
+            // 短 run 并入当前 literal 段。
+            i += runLen;
+        }
+    }
+    if (litStart < size) {
+        emit_literal(litStart, size);
+    }
+    if (g_stats_enabled) {
+        stats_add("encode_ms", codec_core::now_ms() - t0);
+        stats_add("run_segments", static_cast<double>(runSegments));
+        stats_add("literal_segments", static_cast<double>(literalSegments));
+    }
+}
+
+// 解码 v2 段流（调用前魔数已被消费）。
+static bool rle2_decode_stream(std::istream& in, DecodeSink& sink) {
+    const std::size_t BUF_SIZE = 1u << 16;
+    std::vector<char> buffer(BUF_SIZE);
+
+    for (;;) {
+        uint64_t token = 0;
+        if (!read_varint(in, token)) {
+            return !in.bad() && sink.finish();
+        }
+        uint64_t length = token >> 1;
+        if (length == 0) {
+            std::cerr << "RLE 数据非法：段长度不应为 0\n";
+            return false;
+        }
+        if (token & 1) {
+            int c = in.get();
+            if (c == EOF) {
+                std::cerr << "RLE 数据截断：缺少 value 字节\n";
+                return false;
+            }
+            if (!sink.fill(static_cast<uint8_t>(c), length)) {
+                return false;
+            }
+        } else {
+            while (length > 0) {
+                std::size_t chunk = static_cast<std::size_t>(
+                    std::min<uint64_t>(length, BUF_SIZE));
+                in.read(buffer.data(), static_cast<std::streamsize>(chunk));
+                if (in.gcount() != static_cast<std::streamsize>(chunk)) {
+                    std::cerr << "RLE 数据截断：literal 段不完整\n";
+                    return false;
+                }
+                if (!sink.append(buffer.data(), chunk)) {
+                    return false;
+                }
+                length -= chunk;
+            }
+        }
+    }
+}
+
+// 从内存 span 中读取一个 varint（语义同流式 read_varint，但不依赖
+// iostream）。超长或截断时返回 false。
+static bool read_varint_span(const uint8_t* data, size_t size, size_t& pos, uint64_t& out_value) {
+    uint64_t value = 0;
+    int shift = 0;
+    for (int i = 0; i < 10 && pos < size; i++) {
+        uint8_t c = data[pos++];
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            out_value = value;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+// 解码一段内存中的 RLE 数据（按魔数自动识别 v1/v2），结果追加到 out
+// 缓冲区。与编码侧的纯内存入口配对，路径上没有 iostream。
+bool rle_decode_data(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    double t0 = codec_core::now_ms();
+    if (size >= 4 && data[0] == 'R' && data[1] == 'L' && data[2] == 'E' && data[3] == '2') {
+        size_t pos = 4;
+        while (pos < size) {
+            uint64_t token = 0;
+            if (!read_varint_span(data, size, pos, token)) {
+                std::cerr << "RLE 数据截断：varint 不完整\n";
+                return false;
+            }
+            uint64_t length = token >> 1;
+            if (length == 0) {
+                std::cerr << "RLE 数据非法：段长度不应为 0\n";
+                return false;
+            }
+            if (token & 1) {
+                if (pos >= size) {
+                    std::cerr << "RLE 数据截断：缺少 value 字节\n";
+                    return false;
+                }
+                out.insert(out.end(), static_cast<size_t>(length), data[pos++]);
+            } else {
+                if (length > size - pos) {
+                    std::cerr << "RLE 数据截断：literal 段不完整\n";
+                    return false;
+                }
+                out.insert(out.end(), data + pos, data + pos + length);
+                pos += static_cast<size_t>(length);
+            }
+        }
+        stats_add("decode_ms", codec_core::now_ms() - t0);
+        return true;
+    }
+
+    size_t pos = 0;
+    uint64_t runs = 0;
+    while (pos < size) {
+        if (size - pos < 5) {
+            std::cerr << "RLE 数据截断：无法读取完整的 count 字段\n";
+            return false;
+        }
+        uint32_t count =
+            (static_cast<uint32_t>(data[pos])      ) |
+            (static_cast<uint32_t>(data[pos + 1]) << 8 ) |
+            (static_cast<uint32_t>(data[pos + 2]) << 16) |
+            (static_cast<uint32_t>(data[pos + 3]) << 24);
+        uint8_t value = data[pos + 4];
+        pos += 5;
+        if (count == 0) {
+            std::cerr << "RLE 数据非法：count 不应为 0\n";
+            return false;
+        }
+        out.insert(out.end(), count, value);
+        runs++;
+    }
+    if (g_stats_enabled) {
+        stats_add("decode_ms", codec_core::now_ms() - t0);
+        stats_add("runs", static_cast<double>(runs));
+    }
+    return true;
+}
+
+// 把整个输入读入内存（优先 mmap），供文件编码入口复用。
+static bool load_input(const std::string& inputPath, MappedFile& mapped,
+                       std::vector<uint8_t>& fallback,
+                       const uint8_t*& data, size_t& size) {
+    if (mapped.mapped()) {
+        data = mapped.data();
+        size = mapped.size();
+        return true;
+    }
     std::ifstream in(inputPath, std::ios::binary);
     if (!in) {
         std::cerr << "无法打开输入文件用于读取: " << inputPath << "\n";
         return false;
     }
+    fallback.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    data = fallback.data();
+    size = fallback.size();
+    return true;
+}
+
+// 对整个文件进行 v2 混合编码：读入（或映射）整个输入，调用内存入口，
+// 再把结果一次性写出。
+static bool rle2_encode_file_checked(const std::string& inputPath, const std::string& outputPath) {
+    MappedFile mapped(inputPath);
+    std::vector<uint8_t> fallback;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    if (!load_input(inputPath, mapped, fallback, data, size)) {
+        return false;
+    }
+
     std::ofstream out(outputPath, std::ios::binary);
     if (!out) {
         std::cerr << "无法打开输出文件用于写入: " << outputPath << "\n";
         return false;
     }
-
-    char c;
-    if (!in.get(c)) {
-        // 空文件，编码结果也是空文件。
-        return true;
+    std::vector<uint8_t> encoded;
+    rle2_encode_data(data, size, encoded);
+    out.write(reinterpret_cast<const char*>(encoded.data()),
+              static_cast<std::streamsize>(encoded.size()));
+    if (!out) {
+        std::cerr << "写入 RLE 数据失败\n";
+        return false;
     }
-    unsigned char current = static_cast<unsigned char>(c);
-    uint32_t count = 1;
+    return true;
+}
 
-    while (in.get(c)) {
-        unsigned char b = static_cast<unsigned char>(c);
-        if (b == current && count < 0xFFFFFFFFu) {
-            ++count;
-        } else {
-            write_u32_le(out, count);
-            out.put(static_cast<char>(current));
-            if (!out) {
-                std::cerr << "写入 RLE 数据失败\n";
-                return false;
-            }
-            current = b;
-            count = 1;
-        }
+// 对整个文件进行 Run-Length 编码（v1），同样是内存入口的薄封装。
+// inputPath  为原始二进制文件路径。
+// outputPath 为编码后文件路径。
+static bool rle_encode_file_checked(const std::string& inputPath, const std::string& outputPath) {
+    MappedFile mapped(inputPath);
+    std::vector<uint8_t> fallback;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    if (!load_input(inputPath, mapped, fallback, data, size)) {
+        return false;
     }
 
-    // 写出最后一段
-    write_u32_le(out, count);
-    out.put(static_cast<char>(current));
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "无法打开输出文件用于写入: " << outputPath << "\n";
+        return false;
+    }
+    std::vector<uint8_t> encoded;
+    rle_encode_data(data, size, encoded);
+    out.write(reinterpret_cast<const char*>(encoded.data()),
+              static_cast<std::streamsize>(encoded.size()));
     if (!out) {
         std::cerr << "写入 RLE 数据失败\n";
         return false;
     }
-
     return true;
 }
 
 // 对 RLE 编码后的文件进行解码，还原原始字节流。
 // inputPath  为已编码文件路径。
 // outputPath 为解码输出文件路径。
-static bool rle_decode_file_checked(const std::string& inputPath, const std::string& outputPath) {
+// bufferSize 为输出缓冲区大小（0 表示使用默认值 4 MiB）。
+// sparse 为 true 时，长零 run 在输出上打洞而不是写零（见 DecodeSink）；
+// v2 的 run 长度本身就是 varint（64 位），超过 4 GiB 的 run 无需额外记录。
+static bool rle_decode_file_checked(const std::string& inputPath, const std::string& outputPath,
+                                    std::size_t bufferSize, bool sparse) {
     std::ifstream in(inputPath, std::ios::binary);
     if (!in) {
         std::cerr << "无法打开输入文件用于读取: " << inputPath << "\n";
         return false;
     }
-    std::ofstream out(outputPath, std::ios::binary);
-    if (!out) {
-        std::cerr << "无法打开输出文件用于写入: " << outputPath << "\n";
+    DecodeSink sink(outputPath, bufferSize, sparse);
+    if (!sink.ok()) {
         return false;
     }
+    double t0 = codec_core::now_ms();
 
-    const std::size_t BUF_SIZE = 4096;
-    char buffer[BUF_SIZE];
+    // 先探测 v2 魔数。v1 格式没有魔数，但其首个 count 字段恰好等于
+    // "RLE2"（约 8.4 亿）的概率可以忽略。
+    char magic[4] = {0, 0, 0, 0};
+    in.read(magic, 4);
+    if (in.gcount() == 4 && magic[0] == 'R' && magic[1] == 'L' && magic[2] == 'E' && magic[3] == '2') {
+        bool done = rle2_decode_stream(in, sink);
+        stats_add("decode_ms", codec_core::now_ms() - t0);
+        return done;
+    }
+    in.clear();
+    in.seekg(0);
 
+    uint64_t runs = 0;
     while (true) {
         uint32_t count = 0;
         if (!read_u32_le(in, count)) {
@@ -142,46 +636,118 @@ static bool rle_decode_file_checked(const std::string& inputPath, const std::str
             std::cerr << "RLE 数据截断：缺少 value 字节\n";
             return false;
         }
-        unsigned char value = static_cast<unsigned char>(valueChar);
-
-        while (count > 0) {
-            std::size_t chunk = static_cast<std::size_t>(std::min<uint32_t>(count, static_cast<uint32_t>(BUF_SIZE)));
-            std::memset(buffer, static_cast<int>(value), chunk);
-            out.write(buffer, static_cast<std::streamsize>(chunk));
-            if (!out) {
-                std::cerr << "写入解码数据失败\n";
-                return false;
-            }
-            count -= static_cast<uint32_t>(chunk);
+        // 相邻同值 run 在 sink 的缓冲区内自然合并，写满才下盘。
+        if (!sink.fill(static_cast<uint8_t>(valueChar), count)) {
+            return false;
         }
+        runs++;
     }
 
-    return true;
+    if (g_stats_enabled) {
+        stats_add("decode_ms", codec_core::now_ms() - t0);
+        stats_add("runs", static_cast<double>(runs));
+    }
+    return sink.finish();
 }
 
 void rle_decode_file(const std::string& inputPath, const std::string& outputPath) {
     (void)rle_decode_file_checked(inputPath, outputPath);
 }
 
+// 批量模式：按清单（每行 "输入 输出"）并行编码一组相互独立的文件。
+// RLE 流本身是顺序格式，没有分块容器，所以每个文件就是一个整体任务，
+// 交给工作窃取线程池调度——空闲线程从别的队列偷任务，直到清单耗尽。
+// useV2 为 true 时走 v2 混合编码，否则走 v1。
+static bool rle_encode_many_checked(const std::string& manifestPath, bool useV2,
+                                    unsigned threadCount) {
+    std::vector<codec_core::ManifestEntry> entries;
+    if (!codec_core::read_manifest(manifestPath, entries)) {
+        std::cerr << "无法读取清单文件: " << manifestPath << "\n";
+        return false;
+    }
+
+    std::atomic<bool> ok(true);
+    unsigned poolThreads = 0;
+    {
+        // g_stats 不是线程安全的，并行阶段先关掉统计，结束后再恢复。
+        bool savedStats = g_stats_enabled;
+        g_stats_enabled = false;
+        codec_core::WorkStealingPool pool(threadCount);
+        poolThreads = pool.size();
+        for (const codec_core::ManifestEntry& entry : entries) {
+            pool.submit([entry, useV2, &ok] {
+                bool done = useV2 ? rle2_encode_file_checked(entry.input, entry.output)
+                                  : rle_encode_file_checked(entry.input, entry.output);
+                if (!done) {
+                    ok.store(false);
+                }
+            });
+        }
+        pool.wait_idle();
+        g_stats_enabled = savedStats;
+    }
+    stats_add("files", static_cast<double>(entries.size()));
+    stats_add("pool_threads", static_cast<double>(poolThreads));
+    return ok.load();
+}
+
+#ifndef ENCODING_NO_MAIN
 int main(int argc, char** argv) {
-    if (argc != 4) {
-        std::cerr << "用法: " << argv[0] << " encode|decode input output\n";
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stats") {
+            g_stats_enabled = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    bool manyMode = !args.empty() && (args[0] == "encode-many" || args[0] == "encode-many-v2");
+    if (manyMode ? (args.size() != 2 && args.size() != 3)
+                 : (args.size() != 3 && args.size() != 4)) {
+        std::cerr << "用法: " << argv[0] << " encode|encode-v2|decode|decode-sparse input output [decode缓冲区大小] [--stats]\n";
+        std::cerr << "      " << argv[0] << " encode-many|encode-many-v2 manifest [线程数] [--stats]\n";
         return 1;
     }
-    std::string mode = argv[1];
-    std::string inputPath = argv[2];
-    std::string outputPath = argv[3];
+    std::string mode = args[0];
+    std::string inputPath = args[1];
+    std::string outputPath = args.size() > 2 ? args[2] : std::string();
 
     bool ok = true;
+    double t0 = codec_core::now_ms();
 
     if (mode == "encode") {
         ok = rle_encode_file_checked(inputPath, outputPath);
-    } else if (mode == "decode") {
-        ok = rle_decode_file_checked(inputPath, outputPath);
+    } else if (mode == "encode-v2") {
+        ok = rle2_encode_file_checked(inputPath, outputPath);
+    } else if (mode == "decode" || mode == "decode-sparse") {
+        std::size_t bufferSize = 0;
+        if (args.size() == 4) {
+            bufferSize = static_cast<std::size_t>(std::stoull(args[3]));
+        }
+        ok = rle_decode_file_checked(inputPath, outputPath, bufferSize, mode == "decode-sparse");
+    } else if (mode == "encode-many" || mode == "encode-many-v2") {
+        unsigned threads = args.size() == 3 ? static_cast<unsigned>(std::stoul(args[2])) : 0;
+        ok = rle_encode_many_checked(inputPath, mode == "encode-many-v2", threads);
     } else {
-        std::cerr << "未知模式: " << mode << "，应为 encode 或 decode\n";
+        std::cerr << "未知模式: " << mode << "，应为 encode、encode-v2、encode-many、encode-many-v2、decode 或 decode-sparse\n";
         return 1;
     }
 
+    if (g_stats_enabled) {
+        double totalMs = codec_core::now_ms() - t0;
+        uint64_t bytesIn = codec_core::file_size(inputPath);
+        uint64_t bytesOut = codec_core::file_size(outputPath);
+        uint64_t symbols = (mode == "decode" || mode == "decode-sparse") ? bytesOut : bytesIn;
+        std::cerr << "STATS tool=rle mode=" << mode
+                  << " ok=" << (ok ? 1 : 0)
+                  << " bytes_in=" << bytesIn
+                  << " bytes_out=" << bytesOut
+                  << " total_ms=" << totalMs
+                  << " symbols_per_s=" << (totalMs > 0.0 ? static_cast<double>(symbols) / (totalMs / 1000.0) : 0.0)
+                  << g_stats.str() << "\n";
+    }
+
     return ok ? 0 : 1;
 }
+#endif // ENCODING_NO_MAIN
@@ -2,76 +2,63 @@
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <iterator>
 
-class BitWriter {
-public:
-    explicit BitWriter(std::ostream& s) : stream(s), buffer(0), bitsInBuffer(0) {}
-
-    void write_bit(int bit) {
-        buffer = static_cast<uint8_t>((buffer << 1) | (bit & 1));
-        bitsInBuffer++;
-        if (bitsInBuffer == 8) {
-            stream.put(static_cast<char>(buffer));
-            bitsInBuffer = 0;
-            buffer = 0;
-        }
-    }
+#include "../../common/codec_core.hpp"
 
-    void flush() {
-        if (bitsInBuffer > 0) {
-            buffer <<= (8 - bitsInBuffer);
-            stream.put(static_cast<char>(buffer));
-            bitsInBuffer = 0;
-            buffer = 0;
-        }
-    }
+namespace arithmetic {
 
-private:
-    std::ostream& stream;
-    uint8_t buffer;
-    int bitsInBuffer;
-};
+using codec_core::MappedFile;
+using codec_core::ThreadPool;
+using codec_core::BitWriter;
+using codec_core::BitReader;
+using codec_core::SymbolLookup;
+using codec_core::build_symbol_lookup;
+using codec_core::build_cumulative;
+using codec_core::histogram_add;
+using codec_core::histogram_reduce;
+using codec_core::write_u32;
+using codec_core::read_u32;
 
-class BitReader {
-public:
-    explicit BitReader(std::istream& s) : stream(s), currentByte(0), bitsRemaining(0), reachedEof(false) {}
-
-    int read_bit() {
-        if (bitsRemaining == 0) {
-            int c = stream.get();
-            if (c == EOF) {
-                reachedEof = true;
-                return 0;
-            }
-            currentByte = static_cast<uint8_t>(c);
-            bitsRemaining = 8;
-        }
-        bitsRemaining--;
-        return (currentByte >> bitsRemaining) & 1;
-    }
+static bool g_stats_enabled = false;
+static std::ostringstream g_stats;
 
-    bool eof() const {
-        return reachedEof;
+static void stats_add(const char* key, double value) {
+    if (g_stats_enabled) {
+        g_stats << ' ' << key << '=' << value;
     }
+}
 
-private:
-    std::istream& stream;
-    uint8_t currentByte;
-    int bitsRemaining;
-    bool reachedEof;
+// Per-phase fields come from the single-stream paths; blocked mode would
+// interleave per-block values from worker threads, so it suspends them and
+// reports only the totals line.
+struct StatsSuspend {
+    bool saved;
+    StatsSuspend() : saved(g_stats_enabled) { g_stats_enabled = false; }
+    ~StatsSuspend() { g_stats_enabled = saved; }
 };
 
 class ArithmeticEncoder {
 public:
     explicit ArithmeticEncoder(BitWriter& w)
-        : writer(w), low(0), high(FULL_RANGE - 1), pendingBits(0) {}
+        : writer(w), low(0), high(FULL_RANGE - 1), pendingBits(0), renorms(0) {}
 
     void encode_symbol(uint32_t symbol, const std::vector<uint32_t>& cumulative) {
+        encode_range(cumulative[symbol], cumulative[symbol + 1], cumulative.back());
+    }
+
+    // Encodes one symbol given its cumulative interval [symLow, symHigh)
+    // and the model total; this is the entry point for adaptive models.
+    void encode_range(uint32_t symLowIn, uint32_t symHighIn, uint32_t totalIn) {
         uint64_t range = high - low + 1;
-        uint64_t total = cumulative.back();
-        uint64_t symLow = cumulative[symbol];
-        uint64_t symHigh = cumulative[symbol + 1];
+        uint64_t total = totalIn;
+        uint64_t symLow = symLowIn;
+        uint64_t symHigh = symHighIn;
 
         high = low + (range * symHigh) / total - 1;
         low = low + (range * symLow) / total;
@@ -92,9 +79,61 @@ public:
             }
             low <<= 1;
             high = (high << 1) | 1;
+            renorms++;
         }
     }
 
+    // Batch entry point mirroring RangeEncoder::encode_symbols: encodes `n`
+    // literal symbols with the table pointer, total and coder state hoisted
+    // into locals so the hot loop avoids reloading members per symbol.
+    void encode_symbols(const uint8_t* src, size_t n, const std::vector<uint32_t>& cumulative) {
+        const uint32_t* cum = cumulative.data();
+        const uint64_t total = cumulative.back();
+        uint64_t lo = low;
+        uint64_t hi = high;
+        uint64_t pending = pendingBits;
+        uint64_t renormCount = renorms;
+
+        for (size_t i = 0; i < n; i++) {
+            uint32_t symbol = src[i];
+            uint64_t range = hi - lo + 1;
+            hi = lo + (range * cum[symbol + 1]) / total - 1;
+            lo = lo + (range * cum[symbol]) / total;
+
+            for (;;) {
+                if (hi < HALF_RANGE) {
+                    writer.write_bit(0);
+                    for (; pending > 0; pending--) {
+                        writer.write_bit(1);
+                    }
+                } else if (lo >= HALF_RANGE) {
+                    writer.write_bit(1);
+                    for (; pending > 0; pending--) {
+                        writer.write_bit(0);
+                    }
+                    lo -= HALF_RANGE;
+                    hi -= HALF_RANGE;
+                } else if (lo >= FIRST_QUARTER && hi < THIRD_QUARTER) {
+                    pending++;
+                    lo -= FIRST_QUARTER;
+                    hi -= FIRST_QUARTER;
+                } else {
+                    break;
+                }
+                lo <<= 1;
+                hi = (hi << 1) | 1;
+                renormCount++;
+            }
+        }
+        low = lo;
+        high = hi;
+        pendingBits = pending;
+        renorms = renormCount;
+    }
+
+    // Renormalization iterations performed so far (one per emitted bit).
+    uint64_t renorm_count() const { return renorms; }
+
     void finish() {
         pendingBits++;
         if (low < FIRST_QUARTER) {
@@ -116,6 +155,7 @@ private:
     uint64_t low;
     uint64_t high;
     uint64_t pendingBits;
+    uint64_t renorms;
 
     void output_bit(int bit) {
         writer.write_bit(bit);
@@ -130,17 +170,15 @@ private:
 class ArithmeticDecoder {
 public:
     explicit ArithmeticDecoder(BitReader& r)
-        : reader(r), low(0), high(FULL_RANGE - 1), code(0) {
+        : reader(r), low(0), high(FULL_RANGE - 1), code(0), renorms(0) {
         for (uint64_t i = 0; i < STATE_BITS; i++) {
             code = (code << 1) | static_cast<uint64_t>(reader.read_bit());
         }
     }
 
     uint32_t decode_symbol(const std::vector<uint32_t>& cumulative) {
-        uint64_t range = high - low + 1;
-        uint64_t total = cumulative.back();
-        uint64_t offset = code - low;
-        uint64_t value = ((offset + 1) * total - 1) / range;
+        uint32_t total = cumulative.back();
+        uint32_t value = decode_target(total);
 
         uint32_t lo = 0;
         uint32_t hi = static_cast<uint32_t>(cumulative.size() - 1);
@@ -154,8 +192,36 @@ public:
         }
         uint32_t symbol = lo;
 
-        uint64_t symLow = cumulative[symbol];
-        uint64_t symHigh = cumulative[symbol + 1];
+        decode_update(cumulative[symbol], cumulative[symbol + 1], total);
+        return symbol;
+    }
+
+    uint32_t decode_symbol(const std::vector<uint32_t>& cumulative, const SymbolLookup& lut) {
+        uint32_t total = cumulative.back();
+        uint32_t value = decode_target(total);
+
+        uint32_t symbol = lut.slot[value >> lut.shift];
+        while (cumulative[symbol + 1] <= value) {
+            symbol++;
+        }
+
+        decode_update(cumulative[symbol], cumulative[symbol + 1], total);
+        return symbol;
+    }
+
+    // Scales the current code value back into [0, total); the caller looks
+    // up which symbol owns that slot and reports it via decode_update.
+    uint32_t decode_target(uint32_t total) {
+        uint64_t range = high - low + 1;
+        uint64_t offset = code - low;
+        return static_cast<uint32_t>(((offset + 1) * static_cast<uint64_t>(total) - 1) / range);
+    }
+
+    void decode_update(uint32_t symLowIn, uint32_t symHighIn, uint32_t totalIn) {
+        uint64_t range = high - low + 1;
+        uint64_t total = totalIn;
+        uint64_t symLow = symLowIn;
+        uint64_t symHigh = symHighIn;
 
         high = low + (range * symHigh) / total - 1;
         low = low + (range * symLow) / total;
@@ -176,11 +242,13 @@ public:
             low <<= 1;
             high = (high << 1) | 1;
             code = (code << 1) | static_cast<uint64_t>(reader.read_bit());
+            renorms++;
         }
-
-        return symbol;
     }
 
+    // Renormalization iterations performed so far (one per consumed bit).
+    uint64_t renorm_count() const { return renorms; }
+
 private:
     static constexpr uint64_t STATE_BITS = 32;
     static constexpr uint64_t FULL_RANGE = (static_cast<uint64_t>(1) << STATE_BITS);
@@ -192,6 +260,7 @@ private:
     uint64_t low;
     uint64_t high;
     uint64_t code;
+    uint64_t renorms;
 };
 
 static const uint32_t SYMBOL_LIMIT = 257;
@@ -199,40 +268,17 @@ static const uint32_t EOF_SYMBOL = SYMBOL_LIMIT - 1;
 static const uint32_t MAX_TOTAL = 1u << 24;
 
 static void scale_frequencies(std::vector<uint32_t>& freq) {
-    uint64_t total = 0;
-    for (uint32_t f : freq) {
-        total += f;
-    }
-    if (total == 0) {
-        for (size_t i = 0; i < freq.size(); i++) {
-            freq[i] = 1;
-        }
-        return;
-    }
-    if (total <= MAX_TOTAL) {
-        return;
-    }
-    uint64_t newTotal = 0;
-    for (size_t i = 0; i < freq.size(); i++) {
-        if (freq[i] == 0) {
-            continue;
-        }
-        uint64_t scaled = static_cast<uint64_t>(freq[i]) * MAX_TOTAL / total;
-        if (scaled == 0) {
-            scaled = 1;
-        }
-        freq[i] = static_cast<uint32_t>(scaled);
-        newTotal += scaled;
-    }
-    if (newTotal == 0) {
-        uint32_t base = MAX_TOTAL / static_cast<uint32_t>(freq.size());
-        if (base == 0) {
-            base = 1;
-        }
-        for (size_t i = 0; i < freq.size(); i++) {
-            freq[i] = base;
-        }
-    }
+    codec_core::scale_frequencies(freq, MAX_TOTAL);
+}
+
+static std::vector<uint32_t> build_frequencies_from_data(const uint8_t* data, size_t size) {
+    std::vector<uint32_t> freq(SYMBOL_LIMIT, 0);
+    std::vector<uint32_t> counts(4 * 256, 0);
+    histogram_add(data, size, counts.data());
+    histogram_reduce(counts.data(), freq);
+    freq[EOF_SYMBOL] = 1;
+    scale_frequencies(freq);
+    return freq;
 }
 
 static std::vector<uint32_t> build_frequencies_from_file(const std::string& inputPath) {
@@ -241,100 +287,361 @@ static std::vector<uint32_t> build_frequencies_from_file(const std::string& inpu
     if (!in) {
         return freq;
     }
-    char c;
-    while (in.get(c)) {
-        unsigned char uc = static_cast<unsigned char>(c);
-        freq[static_cast<uint32_t>(uc)]++;
+    std::vector<uint32_t> counts(4 * 256, 0);
+    std::vector<uint8_t> buffer(1u << 16);
+    for (;;) {
+        in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        size_t got = static_cast<size_t>(in.gcount());
+        if (got == 0) {
+            break;
+        }
+        histogram_add(buffer.data(), got, counts.data());
     }
+    histogram_reduce(counts.data(), freq);
     freq[EOF_SYMBOL] = 1;
     scale_frequencies(freq);
     return freq;
 }
 
-static std::vector<uint32_t> build_cumulative(const std::vector<uint32_t>& freq) {
-    std::vector<uint32_t> cumulative(freq.size() + 1, 0);
-    for (size_t i = 0; i < freq.size(); i++) {
-        cumulative[i + 1] = cumulative[i] + freq[i];
+// Adaptive symbol model over a Fenwick (binary indexed) tree. Cumulative
+// frequency queries and per-symbol updates are both O(log SYMBOL_LIMIT);
+// encoder and decoder apply identical updates and so stay in sync without
+// any frequency table in the stream.
+class FenwickModel {
+public:
+    FenwickModel() : tree_(SYMBOL_LIMIT + 1, 0), freq_(SYMBOL_LIMIT, 1), total_(0) {
+        rebuild();
     }
-    if (cumulative.back() == 0) {
-        for (size_t i = 0; i < freq.size(); i++) {
-            cumulative[i + 1] = static_cast<uint32_t>(i + 1);
+
+    uint32_t total() const { return total_; }
+
+    uint32_t frequency(uint32_t symbol) const { return freq_[symbol]; }
+
+    // Cumulative frequency of all symbols strictly below `symbol`.
+    uint32_t cumulative(uint32_t symbol) const {
+        uint32_t sum = 0;
+        for (uint32_t i = symbol; i > 0; i -= i & (~i + 1)) {
+            sum += tree_[i];
         }
+        return sum;
     }
-    return cumulative;
-}
 
-static void write_frequencies(std::ostream& out, const std::vector<uint32_t>& freq) {
-    uint32_t count = static_cast<uint32_t>(freq.size());
-    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
-    for (uint32_t v : freq) {
-        out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    // Finds the symbol owning the slot `value` (with value < total) by
+    // descending the tree top-down; also reports the symbol's cumulative
+    // start so the caller avoids a second query.
+    uint32_t find(uint32_t value, uint32_t& symLow) const {
+        uint32_t idx = 0;
+        uint32_t low = 0;
+        for (uint32_t mask = TOP_BIT; mask != 0; mask >>= 1) {
+            uint32_t next = idx + mask;
+            if (next <= SYMBOL_LIMIT && tree_[next] <= value) {
+                idx = next;
+                value -= tree_[next];
+                low += tree_[next];
+            }
+        }
+        symLow = low;
+        return idx;
+    }
+
+    void update(uint32_t symbol) {
+        freq_[symbol] += INCREMENT;
+        total_ += INCREMENT;
+        for (uint32_t i = symbol + 1; i <= SYMBOL_LIMIT; i += i & (~i + 1)) {
+            tree_[i] += INCREMENT;
+        }
+        if (total_ > MAX_TOTAL) {
+            rescale();
+        }
+    }
+
+private:
+    static const uint32_t INCREMENT = 32;
+    static const uint32_t TOP_BIT = 256;
+
+    // Halve all counts (keeping each >= 1) and rebuild the tree in O(n).
+    void rescale() {
+        for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+            freq_[s] = (freq_[s] + 1) / 2;
+        }
+        rebuild();
+    }
+
+    void rebuild() {
+        std::fill(tree_.begin(), tree_.end(), 0);
+        total_ = 0;
+        for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+            total_ += freq_[s];
+            for (uint32_t i = s + 1; i <= SYMBOL_LIMIT; i += i & (~i + 1)) {
+                tree_[i] += freq_[s];
+            }
+        }
+    }
+
+    std::vector<uint32_t> tree_;
+    std::vector<uint32_t> freq_;
+    uint32_t total_;
+};
+
+// Order-1 adaptive model: one FenwickModel-style table per preceding byte,
+// all 256 of them packed into a single contiguous allocation. Each context
+// is padded to a cache-line boundary so switching contexts is one pointer
+// bump into the flat array rather than a chase through nested vectors.
+class Order1Model {
+public:
+    Order1Model() : contexts_(CONTEXTS) {
+        for (Context& ctx : contexts_) {
+            std::fill(ctx.freq, ctx.freq + SYMBOL_LIMIT, 1u);
+            rebuild(ctx);
+        }
+        ctx_ = &contexts_[0];
+    }
+
+    // Selects the table keyed by the previously coded byte.
+    void set_context(uint32_t prev) { ctx_ = &contexts_[prev]; }
+
+    uint32_t total() const { return ctx_->total; }
+
+    uint32_t frequency(uint32_t symbol) const { return ctx_->freq[symbol]; }
+
+    // Cumulative frequency of all symbols strictly below `symbol` in the
+    // current context.
+    uint32_t cumulative(uint32_t symbol) const {
+        uint32_t sum = 0;
+        for (uint32_t i = symbol; i > 0; i -= i & (~i + 1)) {
+            sum += ctx_->tree[i];
+        }
+        return sum;
+    }
+
+    // Finds the symbol owning the slot `value` (with value < total) in the
+    // current context; also reports the symbol's cumulative start.
+    uint32_t find(uint32_t value, uint32_t& symLow) const {
+        const uint32_t* tree = ctx_->tree;
+        uint32_t idx = 0;
+        uint32_t low = 0;
+        for (uint32_t mask = TOP_BIT; mask != 0; mask >>= 1) {
+            uint32_t next = idx + mask;
+            if (next <= SYMBOL_LIMIT && tree[next] <= value) {
+                idx = next;
+                value -= tree[next];
+                low += tree[next];
+            }
+        }
+        symLow = low;
+        return idx;
+    }
+
+    void update(uint32_t symbol) {
+        Context& ctx = *ctx_;
+        ctx.freq[symbol] += INCREMENT;
+        ctx.total += INCREMENT;
+        for (uint32_t i = symbol + 1; i <= SYMBOL_LIMIT; i += i & (~i + 1)) {
+            ctx.tree[i] += INCREMENT;
+        }
+        if (ctx.total > MAX_TOTAL) {
+            rescale(ctx);
+        }
+    }
+
+private:
+    static const uint32_t CONTEXTS = 256;
+    static const uint32_t INCREMENT = 32;
+    static const uint32_t TOP_BIT = 256;
+
+    struct alignas(64) Context {
+        uint32_t tree[SYMBOL_LIMIT + 1];
+        uint32_t freq[SYMBOL_LIMIT];
+        uint32_t total;
+    };
+
+    // Halve all counts of one context (keeping each >= 1) and rebuild it.
+    static void rescale(Context& ctx) {
+        for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+            ctx.freq[s] = (ctx.freq[s] + 1) / 2;
+        }
+        rebuild(ctx);
+    }
+
+    static void rebuild(Context& ctx) {
+        std::fill(ctx.tree, ctx.tree + SYMBOL_LIMIT + 1, 0u);
+        ctx.total = 0;
+        for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+            ctx.total += ctx.freq[s];
+            for (uint32_t i = s + 1; i <= SYMBOL_LIMIT; i += i & (~i + 1)) {
+                ctx.tree[i] += ctx.freq[s];
+            }
+        }
     }
+
+    std::vector<Context> contexts_;
+    Context* ctx_;
+};
+
+static void write_frequencies(std::ostream& out, const std::vector<uint32_t>& freq) {
+    codec_core::write_frequencies(out, freq);
 }
 
 static bool read_frequencies(std::istream& in, std::vector<uint32_t>& freq) {
-    uint32_t count = 0;
-    in.read(reinterpret_cast<char*>(&count), sizeof(count));
-    if (!in) {
-        std::cerr << "Failed to read frequency table\n";
-        return false;
+    return codec_core::read_frequencies(in, freq, SYMBOL_LIMIT);
+}
+
+// Compresses one byte span into `out` as a self-contained payload:
+// frequency table followed by the EOF-terminated bitstream. The compact
+// flavour serializes the table as varint tokens with zero runs collapsed
+// instead of 257 raw 32-bit counts.
+static bool compress_payload_from_data(const uint8_t* data, size_t size, std::ostream& out,
+                                       bool compactHeader = false) {
+    double t0 = codec_core::now_ms();
+    std::vector<uint32_t> freq = build_frequencies_from_data(data, size);
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
+    double t1 = codec_core::now_ms();
+
+    if (compactHeader) {
+        codec_core::write_frequencies_compact(out, freq);
+    } else {
+        write_frequencies(out, freq);
     }
-    if (count != SYMBOL_LIMIT) {
-        std::cerr << "Bad frequency table size: " << count << "\n";
-        return false;
+    BitWriter bitWriter(out);
+    ArithmeticEncoder encoder(bitWriter);
+    encoder.encode_symbols(data, size, cumulative);
+    encoder.encode_symbol(EOF_SYMBOL, cumulative);
+    encoder.finish();
+    if (g_stats_enabled) {
+        stats_add("histogram_ms", t1 - t0);
+        stats_add("encode_ms", codec_core::now_ms() - t1);
+        stats_add("renorms", static_cast<double>(encoder.renorm_count()));
     }
-    freq.assign(count, 0);
-    in.read(reinterpret_cast<char*>(freq.data()), freq.size() * sizeof(uint32_t));
-    if (!in) {
-        std::cerr << "Failed to read frequency table\n";
+    return static_cast<bool>(out);
+}
+
+// Decodes one payload (frequency table + EOF-terminated bitstream) from
+// `in`; `compactHeader` selects the table serialization.
+static bool decompress_payload(std::istream& in, std::ostream& out, bool compactHeader = false) {
+    double t0 = codec_core::now_ms();
+    std::vector<uint32_t> freq;
+    if (compactHeader ? !codec_core::read_frequencies_compact(in, freq, SYMBOL_LIMIT)
+                      : !read_frequencies(in, freq)) {
         return false;
     }
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
+    SymbolLookup lut = build_symbol_lookup(cumulative);
+
+    BitReader bitReader(in);
+    ArithmeticDecoder decoder(bitReader);
+    double t1 = codec_core::now_ms();
+    stats_add("setup_ms", t1 - t0);
+
+    for (;;) {
+        uint32_t sym = decoder.decode_symbol(cumulative, lut);
+        if (sym == EOF_SYMBOL) {
+            break;
+        }
+        unsigned char b = static_cast<unsigned char>(sym);
+        out.put(static_cast<char>(b));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+    }
+    if (g_stats_enabled) {
+        stats_add("decode_ms", codec_core::now_ms() - t1);
+        stats_add("renorms", static_cast<double>(decoder.renorm_count()));
+    }
     return true;
 }
 
-static bool compress_file(const std::string& inputPath, const std::string& outputPath) {
-    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
-    std::vector<uint32_t> cumulative = build_cumulative(freq);
-
+// Preset-dictionary mode, mirroring the huffman tool: the table is trained
+// once into a sidecar (codec_core "FDIC" format, interchangeable between
+// the two tools) and the output carries only the "AEPD" magic plus the
+// bitstream. Training clamps every symbol to at least one count so bytes
+// absent from the training corpus remain encodable.
+static bool train_dictionary(const std::string& inputPath, const std::string& dictPath) {
     std::ifstream in(inputPath, std::ios::binary);
     if (!in) {
         std::cerr << "Cannot open input file for reading\n";
         return false;
     }
+    in.close();
+    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
+    for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+        if (freq[s] == 0) {
+            freq[s] = 1;
+        }
+    }
+    if (!codec_core::write_dictionary(dictPath, freq)) {
+        std::cerr << "Cannot write dictionary file\n";
+        return false;
+    }
+    return true;
+}
+
+// Tables derived from one dictionary, built once per process and reused
+// across every file encoded or decoded with it.
+struct PresetCodec {
+    std::vector<uint32_t> cumulative;
+    SymbolLookup lut;
+};
+
+static bool load_preset(const std::string& dictPath, PresetCodec& preset) {
+    std::vector<uint32_t> freq;
+    if (!codec_core::read_dictionary(dictPath, freq, SYMBOL_LIMIT)) {
+        std::cerr << "Cannot read dictionary file\n";
+        return false;
+    }
+    preset.cumulative = build_cumulative(freq);
+    preset.lut = build_symbol_lookup(preset.cumulative);
+    return true;
+}
+
+static bool compress_file_preset(const PresetCodec& preset, const std::string& inputPath,
+                                 const std::string& outputPath) {
+    MappedFile mapped(inputPath);
+
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
     std::ofstream out(outputPath, std::ios::binary);
     if (!out) {
         std::cerr << "Cannot open output file for writing\n";
         return false;
     }
 
-    const char magic[4] = {'A', 'E', 'N', 'C'};
+    const char magic[4] = {'A', 'E', 'P', 'D'};
     out.write(magic, sizeof(magic));
-    write_frequencies(out, freq);
 
     BitWriter bitWriter(out);
     ArithmeticEncoder encoder(bitWriter);
-
-    char c;
-    while (in.get(c)) {
-        uint32_t sym = static_cast<uint8_t>(c);
-        encoder.encode_symbol(sym, cumulative);
+    if (mapped.mapped()) {
+        encoder.encode_symbols(mapped.data(), mapped.size(), preset.cumulative);
+    } else {
+        char c;
+        while (in.get(c)) {
+            encoder.encode_symbol(static_cast<uint32_t>(static_cast<uint8_t>(c)),
+                                  preset.cumulative);
+        }
+        if (in.bad()) {
+            std::cerr << "Failed to read input file\n";
+            return false;
+        }
     }
-    encoder.encode_symbol(EOF_SYMBOL, cumulative);
+    encoder.encode_symbol(EOF_SYMBOL, preset.cumulative);
     encoder.finish();
-
-    if (in.bad()) {
-        std::cerr << "Failed to read input file\n";
-        return false;
-    }
     if (!out) {
         std::cerr << "Failed to write output file\n";
         return false;
     }
-
     return true;
 }
 
-static bool decompress_file(const std::string& inputPath, const std::string& outputPath) {
+static bool decompress_file_preset(const PresetCodec& preset, const std::string& inputPath,
+                                   const std::string& outputPath) {
     std::ifstream in(inputPath, std::ios::binary);
     if (!in) {
         std::cerr << "Cannot open input file for reading\n";
@@ -342,17 +649,11 @@ static bool decompress_file(const std::string& inputPath, const std::string& out
     }
     char magic[4] = {};
     in.read(magic, sizeof(magic));
-    if (!in || magic[0] != 'A' || magic[1] != 'E' || magic[2] != 'N' || magic[3] != 'C') {
+    if (!in || magic[0] != 'A' || magic[1] != 'E' || magic[2] != 'P' || magic[3] != 'D') {
         std::cerr << "Invalid input file format\n";
         return false;
     }
 
-    std::vector<uint32_t> freq;
-    if (!read_frequencies(in, freq)) {
-        return false;
-    }
-    std::vector<uint32_t> cumulative = build_cumulative(freq);
-
     std::ofstream out(outputPath, std::ios::binary);
     if (!out) {
         std::cerr << "Cannot open output file for writing\n";
@@ -361,42 +662,1170 @@ static bool decompress_file(const std::string& inputPath, const std::string& out
 
     BitReader bitReader(in);
     ArithmeticDecoder decoder(bitReader);
-
     for (;;) {
-        uint32_t sym = decoder.decode_symbol(cumulative);
+        uint32_t sym = decoder.decode_symbol(preset.cumulative, preset.lut);
         if (sym == EOF_SYMBOL) {
             break;
         }
-        unsigned char b = static_cast<unsigned char>(sym);
-        out.put(static_cast<char>(b));
+        out.put(static_cast<char>(static_cast<unsigned char>(sym)));
         if (!out) {
             std::cerr << "Failed to write output file\n";
             return false;
         }
     }
+    return true;
+}
+
+// Archive mode, sharing its container layout with the huffman tool: many
+// members behind one "AEAR" magic and one frequency table, each member an
+// independently terminated bitstream, plus a trailing index (per member:
+// varint name length, name bytes, u64 offset / raw size / compressed size)
+// closed by u64 index size, u32 member count and the "ARIX" tail. One table
+// and one model build amortize over the whole member list, which is the
+// point when the members are thousands of small files.
 
+struct ArchiveEntry {
+    std::string name;
+    uint64_t offset;
+    uint64_t rawSize;
+    uint64_t compSize;
+};
+
+static std::string archive_member_name(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool read_archive_index(std::istream& in, std::vector<ArchiveEntry>& entries) {
+    in.seekg(-16, std::ios::end);
+    uint64_t indexBytes = 0;
+    uint32_t count = 0;
+    char tail[4] = {};
+    if (!codec_core::read_u64(in, indexBytes) || !read_u32(in, count)) {
+        return false;
+    }
+    in.read(tail, sizeof(tail));
+    if (!in || tail[0] != 'A' || tail[1] != 'R' || tail[2] != 'I' || tail[3] != 'X') {
+        return false;
+    }
+    in.seekg(-16 - static_cast<std::streamoff>(indexBytes), std::ios::end);
+    entries.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        ArchiveEntry entry;
+        uint64_t nameLen = 0;
+        if (!codec_core::read_varint(in, nameLen) || nameLen == 0 || nameLen > 4096) {
+            return false;
+        }
+        entry.name.resize(static_cast<size_t>(nameLen));
+        in.read(&entry.name[0], static_cast<std::streamsize>(nameLen));
+        if (!in || !codec_core::read_u64(in, entry.offset) ||
+            !codec_core::read_u64(in, entry.rawSize) ||
+            !codec_core::read_u64(in, entry.compSize)) {
+            return false;
+        }
+        entries.push_back(std::move(entry));
+    }
     return true;
 }
 
-int main(int argc, char** argv) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " encode|decode input output\n";
-        return 1;
+static bool create_archive(const std::string& archivePath,
+                           const std::vector<std::string>& members) {
+    // Pass 1: one histogram over every member; the scaled table goes into
+    // the shared header exactly like the single-file AENC header.
+    std::vector<uint32_t> counts(4 * 256, 0);
+    std::vector<uint8_t> buffer(1u << 16);
+    for (const std::string& path : members) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading: " << path << "\n";
+            return false;
+        }
+        for (;;) {
+            in.read(reinterpret_cast<char*>(buffer.data()),
+                    static_cast<std::streamsize>(buffer.size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
+                break;
+            }
+            histogram_add(buffer.data(), got, counts.data());
+        }
     }
-    std::string mode = argv[1];
-    std::string inputPath = argv[2];
-    std::string outputPath = argv[3];
+    std::vector<uint32_t> freq(SYMBOL_LIMIT, 0);
+    histogram_reduce(counts.data(), freq);
+    freq[EOF_SYMBOL] = 1;
+    scale_frequencies(freq);
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
 
-    bool ok = true;
+    std::ofstream out(archivePath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+    const char magic[4] = {'A', 'E', 'A', 'R'};
+    out.write(magic, sizeof(magic));
+    write_frequencies(out, freq);
 
-    if (mode == "encode") {
-        ok = compress_file(inputPath, outputPath);
-    } else if (mode == "decode") {
-        ok = decompress_file(inputPath, outputPath);
-    } else {
-        std::cerr << "Unknown mode\n";
-        return 1;
+    // Pass 2: one coder per member so each bitstream terminates on its own
+    // EOF symbol and decodes independently of its neighbours.
+    std::vector<ArchiveEntry> entries;
+    for (const std::string& path : members) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading: " << path << "\n";
+            return false;
+        }
+        ArchiveEntry entry;
+        entry.name = archive_member_name(path);
+        entry.offset = static_cast<uint64_t>(out.tellp());
+        entry.rawSize = 0;
+
+        BitWriter bitWriter(out);
+        ArithmeticEncoder encoder(bitWriter);
+        for (;;) {
+            in.read(reinterpret_cast<char*>(buffer.data()),
+                    static_cast<std::streamsize>(buffer.size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
+                break;
+            }
+            encoder.encode_symbols(buffer.data(), got, cumulative);
+            entry.rawSize += got;
+        }
+        encoder.encode_symbol(EOF_SYMBOL, cumulative);
+        encoder.finish();
+        entry.compSize = static_cast<uint64_t>(out.tellp()) - entry.offset;
+        entries.push_back(std::move(entry));
+    }
+
+    uint64_t indexStart = static_cast<uint64_t>(out.tellp());
+    for (const ArchiveEntry& entry : entries) {
+        codec_core::write_varint(out, entry.name.size());
+        out.write(entry.name.data(), static_cast<std::streamsize>(entry.name.size()));
+        codec_core::write_u64(out, entry.offset);
+        codec_core::write_u64(out, entry.rawSize);
+        codec_core::write_u64(out, entry.compSize);
+    }
+    codec_core::write_u64(out, static_cast<uint64_t>(out.tellp()) - indexStart);
+    write_u32(out, static_cast<uint32_t>(entries.size()));
+    const char tail[4] = {'A', 'R', 'I', 'X'};
+    out.write(tail, sizeof(tail));
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+static bool open_archive(const std::string& archivePath, std::ifstream& in,
+                         std::vector<ArchiveEntry>& entries) {
+    in.open(archivePath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || magic[0] != 'A' || magic[1] != 'E' || magic[2] != 'A' || magic[3] != 'R') {
+        std::cerr << "Invalid input file format\n";
+        return false;
+    }
+    if (!read_archive_index(in, entries)) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+    return true;
+}
+
+static bool list_archive(const std::string& archivePath) {
+    std::ifstream in;
+    std::vector<ArchiveEntry> entries;
+    if (!open_archive(archivePath, in, entries)) {
+        return false;
+    }
+    for (const ArchiveEntry& entry : entries) {
+        std::cout << entry.name << " " << entry.rawSize << " " << entry.compSize << "\n";
+    }
+    return true;
+}
+
+// Extracts one member (by name) or, with an empty name, every member into
+// `outputDir`. Cumulative table and lookup are built once and shared.
+static bool extract_archive(const std::string& archivePath, const std::string& outputDir,
+                            const std::string& memberName) {
+    std::ifstream in;
+    std::vector<ArchiveEntry> entries;
+    if (!open_archive(archivePath, in, entries)) {
+        return false;
+    }
+
+    in.clear();
+    in.seekg(4);
+    std::vector<uint32_t> freq;
+    if (!read_frequencies(in, freq)) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
+    SymbolLookup lut = build_symbol_lookup(cumulative);
+
+#ifdef CODEC_HAVE_MMAP
+    ::mkdir(outputDir.c_str(), 0755);
+#endif
+
+    bool found = memberName.empty();
+    for (const ArchiveEntry& entry : entries) {
+        if (!memberName.empty() && entry.name != memberName) {
+            continue;
+        }
+        found = true;
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(entry.offset));
+        std::ofstream out(outputDir + "/" + entry.name, std::ios::binary);
+        if (!out) {
+            std::cerr << "Cannot open output file for writing: "
+                      << outputDir + "/" + entry.name << "\n";
+            return false;
+        }
+        BitReader bitReader(in);
+        ArithmeticDecoder decoder(bitReader);
+        for (;;) {
+            uint32_t sym = decoder.decode_symbol(cumulative, lut);
+            if (sym == EOF_SYMBOL) {
+                break;
+            }
+            out.put(static_cast<char>(static_cast<unsigned char>(sym)));
+            if (!out) {
+                std::cerr << "Failed to write output file\n";
+                return false;
+            }
+        }
+    }
+    if (!found) {
+        std::cerr << "Member not found in archive: " << memberName << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool compress_file(const std::string& inputPath, const std::string& outputPath) {
+    // One mapping serves both the histogram pass and the encode pass; the
+    // streaming path below opens the file twice instead.
+    MappedFile mapped(inputPath);
+
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    const char magic[4] = {'A', 'E', 'N', 'C'};
+    out.write(magic, sizeof(magic));
+
+    if (mapped.mapped()) {
+        if (!compress_payload_from_data(mapped.data(), mapped.size(), out)) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
+
+    write_frequencies(out, freq);
+
+    BitWriter bitWriter(out);
+    ArithmeticEncoder encoder(bitWriter);
+
+    char c;
+    while (in.get(c)) {
+        uint32_t sym = static_cast<uint8_t>(c);
+        encoder.encode_symbol(sym, cumulative);
+    }
+    if (in.bad()) {
+        std::cerr << "Failed to read input file\n";
+        return false;
+    }
+    encoder.encode_symbol(EOF_SYMBOL, cumulative);
+    encoder.finish();
+    stats_add("renorms", static_cast<double>(encoder.renorm_count()));
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+
+    return true;
+}
+
+// Pipelined single-stream encode, producing the same AENC output as
+// compress_file: a reader thread fills double buffers, this thread runs
+// the coder, and a writer thread drains completed output buffers, so
+// I/O on both ends overlaps the (comparatively slow) symbol loop.
+static bool compress_file_pipelined(const std::string& inputPath, const std::string& outputPath) {
+    static const size_t CHUNK_SIZE = 1u << 20;
+
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
+
+    const char magic[4] = {'A', 'E', 'N', 'C'};
+    out.write(magic, sizeof(magic));
+    write_frequencies(out, freq);
+
+    codec_core::BufferQueue inQueue(2);
+    codec_core::BufferQueue outQueue(2);
+
+    std::thread reader([&] {
+        for (;;) {
+            std::vector<char> buf(CHUNK_SIZE);
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
+                break;
+            }
+            buf.resize(got);
+            inQueue.push(std::move(buf));
+            if (got < CHUNK_SIZE) {
+                break;
+            }
+        }
+        inQueue.close();
+    });
+
+    bool writeOk = true;
+    std::thread writer([&] {
+        std::vector<char> buf;
+        while (outQueue.pop(buf)) {
+            out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+            if (!out) {
+                writeOk = false;
+            }
+        }
+    });
+
+    {
+        codec_core::QueueStreamBuf qbuf(outQueue, 1u << 16);
+        std::ostream qout(&qbuf);
+        BitWriter bitWriter(qout);
+        ArithmeticEncoder encoder(bitWriter);
+        std::vector<char> chunk;
+        while (inQueue.pop(chunk)) {
+            for (char c : chunk) {
+                encoder.encode_symbol(static_cast<uint32_t>(static_cast<uint8_t>(c)), cumulative);
+            }
+        }
+        encoder.encode_symbol(EOF_SYMBOL, cumulative);
+        encoder.finish();
+        qout.flush();
+    }
+    outQueue.close();
+    reader.join();
+    writer.join();
+
+    if (in.bad()) {
+        std::cerr << "Failed to read input file\n";
+        return false;
+    }
+    if (!writeOk || !out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+// Compact-header container ("AECN"): the AENC bitstream behind a varint
+// frequency table, typically tens of bytes instead of the fixed 1032.
+// AENC stays the default for compatibility with existing archives.
+static bool compress_file_compact(const std::string& inputPath, const std::string& outputPath) {
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+    const char magic[4] = {'A', 'E', 'C', 'N'};
+    out.write(magic, sizeof(magic));
+
+    MappedFile mapped(inputPath);
+    if (mapped.mapped()) {
+        return compress_payload_from_data(mapped.data(), mapped.size(), out, true);
+    }
+
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    return compress_payload_from_data(data.data(), data.size(), out, true);
+}
+
+// Single-pass adaptive mode: no frequency header, no second read of the
+// input. The model starts uniform and both sides update it after every
+// symbol, so streams that cannot be rewound (sockets, pipes to a file)
+// compress in one pass.
+static bool compress_file_adaptive(const std::string& inputPath, const std::string& outputPath) {
+    MappedFile mapped(inputPath);
+
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    const char magic[4] = {'A', 'E', 'A', 'D'};
+    out.write(magic, sizeof(magic));
+
+    BitWriter bitWriter(out);
+    ArithmeticEncoder encoder(bitWriter);
+    FenwickModel model;
+
+    auto encode_one = [&](uint32_t sym) {
+        uint32_t symLow = model.cumulative(sym);
+        encoder.encode_range(symLow, symLow + model.frequency(sym), model.total());
+        model.update(sym);
+    };
+
+    if (mapped.mapped()) {
+        const uint8_t* data = mapped.data();
+        size_t size = mapped.size();
+        for (size_t i = 0; i < size; i++) {
+            encode_one(static_cast<uint32_t>(data[i]));
+        }
+    } else {
+        char c;
+        while (in.get(c)) {
+            encode_one(static_cast<uint32_t>(static_cast<uint8_t>(c)));
+        }
+        if (in.bad()) {
+            std::cerr << "Failed to read input file\n";
+            return false;
+        }
+    }
+    uint32_t eofLow = model.cumulative(EOF_SYMBOL);
+    encoder.encode_range(eofLow, eofLow + model.frequency(EOF_SYMBOL), model.total());
+    encoder.finish();
+    stats_add("renorms", static_cast<double>(encoder.renorm_count()));
+
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+static bool decompress_file_adaptive(std::istream& in, std::ostream& out) {
+    BitReader bitReader(in);
+    ArithmeticDecoder decoder(bitReader);
+    FenwickModel model;
+
+    for (;;) {
+        uint32_t target = decoder.decode_target(model.total());
+        uint32_t symLow = 0;
+        uint32_t sym = model.find(target, symLow);
+        decoder.decode_update(symLow, symLow + model.frequency(sym), model.total());
+        if (sym == EOF_SYMBOL) {
+            break;
+        }
+        model.update(sym);
+        out.put(static_cast<char>(static_cast<unsigned char>(sym)));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+    }
+    stats_add("renorms", static_cast<double>(decoder.renorm_count()));
+    return true;
+}
+
+// Order-1 variant of the adaptive mode: each byte is coded under the table
+// keyed by its predecessor (context 0 for the first byte), which pays off on
+// text where the next byte depends strongly on the current one. Still a
+// single pass with no frequency header.
+static bool compress_file_order1(const std::string& inputPath, const std::string& outputPath) {
+    MappedFile mapped(inputPath);
+
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    const char magic[4] = {'A', 'E', 'O', '1'};
+    out.write(magic, sizeof(magic));
+
+    BitWriter bitWriter(out);
+    ArithmeticEncoder encoder(bitWriter);
+    Order1Model model;
+    uint32_t prev = 0;
+
+    auto encode_one = [&](uint32_t sym) {
+        model.set_context(prev);
+        uint32_t symLow = model.cumulative(sym);
+        encoder.encode_range(symLow, symLow + model.frequency(sym), model.total());
+        model.update(sym);
+        prev = sym;
+    };
+
+    if (mapped.mapped()) {
+        const uint8_t* data = mapped.data();
+        size_t size = mapped.size();
+        for (size_t i = 0; i < size; i++) {
+            encode_one(static_cast<uint32_t>(data[i]));
+        }
+    } else {
+        char c;
+        while (in.get(c)) {
+            encode_one(static_cast<uint32_t>(static_cast<uint8_t>(c)));
+        }
+        if (in.bad()) {
+            std::cerr << "Failed to read input file\n";
+            return false;
+        }
+    }
+    model.set_context(prev);
+    uint32_t eofLow = model.cumulative(EOF_SYMBOL);
+    encoder.encode_range(eofLow, eofLow + model.frequency(EOF_SYMBOL), model.total());
+    encoder.finish();
+    stats_add("renorms", static_cast<double>(encoder.renorm_count()));
+
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+static bool decompress_file_order1(std::istream& in, std::ostream& out) {
+    BitReader bitReader(in);
+    ArithmeticDecoder decoder(bitReader);
+    Order1Model model;
+    uint32_t prev = 0;
+
+    for (;;) {
+        model.set_context(prev);
+        uint32_t target = decoder.decode_target(model.total());
+        uint32_t symLow = 0;
+        uint32_t sym = model.find(target, symLow);
+        decoder.decode_update(symLow, symLow + model.frequency(sym), model.total());
+        if (sym == EOF_SYMBOL) {
+            break;
+        }
+        model.update(sym);
+        prev = sym;
+        out.put(static_cast<char>(static_cast<unsigned char>(sym)));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+    }
+    stats_add("renorms", static_cast<double>(decoder.renorm_count()));
+    return true;
+}
+
+static const uint32_t DEFAULT_BLOCK_SIZE = 1u << 20;
+
+// Block-parallel encode: the input is split into fixed-size blocks, each
+// compressed independently (own frequency table) on the thread pool, and the
+// container records a (raw size, compressed size) pair per block. A zero/zero
+// record terminates the block list.
+static bool compress_file_blocks(const std::string& inputPath, const std::string& outputPath,
+                                 uint32_t blockSize, unsigned threadCount) {
+    StatsSuspend statsSuspend;
+    if (blockSize == 0) {
+        blockSize = DEFAULT_BLOCK_SIZE;
+    }
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+    }
+
+    MappedFile mapped(inputPath);
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    const char magic[4] = {'A', 'E', 'B', 'K'};
+    out.write(magic, sizeof(magic));
+    write_u32(out, blockSize);
+
+    ThreadPool pool(threadCount);
+    using BlockResult = std::pair<uint32_t, std::string>;
+    std::deque<std::future<BlockResult>> pending;
+    // Bound the number of in-flight blocks so memory stays O(threads * block).
+    const size_t window = static_cast<size_t>(threadCount) * 4;
+
+    // Per-block offsets for the seekable index footer; compressed offsets
+    // start past the magic and the block-size field.
+    std::vector<codec_core::BlockIndexEntry> index;
+    uint64_t compOffset = 8;
+    uint64_t rawOffset = 0;
+
+    auto submit_block = [&pool](std::function<BlockResult()> fn) {
+        auto task = std::make_shared<std::packaged_task<BlockResult()>>(std::move(fn));
+        std::future<BlockResult> fut = task->get_future();
+        pool.submit([task] { (*task)(); });
+        return fut;
+    };
+
+    auto write_front = [&]() -> bool {
+        BlockResult block = pending.front().get();
+        pending.pop_front();
+        index.push_back(codec_core::BlockIndexEntry{compOffset, rawOffset});
+        compOffset += 8 + block.second.size();
+        rawOffset += block.first;
+        write_u32(out, block.first);
+        write_u32(out, static_cast<uint32_t>(block.second.size()));
+        out.write(block.second.data(), static_cast<std::streamsize>(block.second.size()));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        return true;
+    };
+
+    if (mapped.mapped()) {
+        const uint8_t* data = mapped.data();
+        size_t size = mapped.size();
+        size_t offset = 0;
+        while (offset < size) {
+            size_t len = std::min<size_t>(blockSize, size - offset);
+            const uint8_t* p = data + offset;
+            pending.push_back(submit_block([p, len]() -> BlockResult {
+                std::ostringstream os;
+                compress_payload_from_data(p, len, os);
+                return BlockResult(static_cast<uint32_t>(len), os.str());
+            }));
+            offset += len;
+            if (pending.size() >= window && !write_front()) {
+                return false;
+            }
+        }
+    } else {
+        for (;;) {
+            auto buf = std::make_shared<std::vector<uint8_t>>(blockSize);
+            in.read(reinterpret_cast<char*>(buf->data()), static_cast<std::streamsize>(buf->size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
+                break;
+            }
+            buf->resize(got);
+            pending.push_back(submit_block([buf]() -> BlockResult {
+                std::ostringstream os;
+                compress_payload_from_data(buf->data(), buf->size(), os);
+                return BlockResult(static_cast<uint32_t>(buf->size()), os.str());
+            }));
+            if (pending.size() >= window && !write_front()) {
+                return false;
+            }
+        }
+        if (in.bad()) {
+            std::cerr << "Failed to read input file\n";
+            return false;
+        }
+    }
+
+    while (!pending.empty()) {
+        if (!write_front()) {
+            return false;
+        }
+    }
+
+    write_u32(out, 0);
+    write_u32(out, 0);
+    codec_core::write_block_index(out, index);
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+// Manifest batch mode on the shared work-stealing pool, structured like
+// the huffman tool's: whole-file tasks for small inputs, and anything of
+// BATCH_SPLIT_SIZE or more split into per-block subtasks that idle
+// workers steal, reassembled into the standard "AEBK" container. Load
+// balance across a mixed nightly manifest is the whole point — one big
+// file becomes many stealable blocks instead of one straggler task.
+
+static const uint64_t BATCH_SPLIT_SIZE = 4ull * DEFAULT_BLOCK_SIZE;
+
+struct BatchFileJob {
+    MappedFile mapped;
+    std::string outputPath;
+    std::vector<std::string> blocks;
+    std::atomic<size_t> remaining;
+    std::atomic<bool>* batchOk;
+
+    BatchFileJob(const std::string& input, const std::string& output, std::atomic<bool>* ok)
+        : mapped(input), outputPath(output), remaining(0), batchOk(ok) {}
+};
+
+static bool write_batch_container(const BatchFileJob& job) {
+    std::ofstream out(job.outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing: " << job.outputPath << "\n";
+        return false;
+    }
+    const char magic[4] = {'A', 'E', 'B', 'K'};
+    out.write(magic, sizeof(magic));
+    write_u32(out, DEFAULT_BLOCK_SIZE);
+
+    std::vector<codec_core::BlockIndexEntry> index;
+    uint64_t compOffset = 8;
+    uint64_t rawOffset = 0;
+    size_t size = job.mapped.size();
+    for (size_t i = 0; i < job.blocks.size(); i++) {
+        uint32_t rawSize = static_cast<uint32_t>(
+            std::min<size_t>(DEFAULT_BLOCK_SIZE, size - i * static_cast<size_t>(DEFAULT_BLOCK_SIZE)));
+        const std::string& payload = job.blocks[i];
+        index.push_back(codec_core::BlockIndexEntry{compOffset, rawOffset});
+        compOffset += 8 + payload.size();
+        rawOffset += rawSize;
+        write_u32(out, rawSize);
+        write_u32(out, static_cast<uint32_t>(payload.size()));
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    }
+    write_u32(out, 0);
+    write_u32(out, 0);
+    codec_core::write_block_index(out, index);
+    if (!out) {
+        std::cerr << "Failed to write output file: " << job.outputPath << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool compress_many(const std::string& manifestPath, unsigned threadCount) {
+    std::vector<codec_core::ManifestEntry> entries;
+    if (!codec_core::read_manifest(manifestPath, entries)) {
+        std::cerr << "Cannot read manifest file\n";
+        return false;
+    }
+
+    std::atomic<bool> ok(true);
+    size_t splitFiles = 0;
+    unsigned poolThreads = 0;
+    {
+        StatsSuspend statsSuspend;
+        codec_core::WorkStealingPool pool(threadCount);
+        poolThreads = pool.size();
+
+        for (const codec_core::ManifestEntry& entry : entries) {
+            if (codec_core::file_size(entry.input) >= BATCH_SPLIT_SIZE) {
+                auto job = std::make_shared<BatchFileJob>(entry.input, entry.output, &ok);
+                if (job->mapped.mapped()) {
+                    splitFiles++;
+                    pool.submit([&pool, job] {
+                        size_t size = job->mapped.size();
+                        size_t blockCount = (size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+                        job->blocks.resize(blockCount);
+                        job->remaining.store(blockCount);
+                        for (size_t i = 0; i < blockCount; i++) {
+                            pool.submit([job, i] {
+                                size_t offset = i * static_cast<size_t>(DEFAULT_BLOCK_SIZE);
+                                size_t len = std::min<size_t>(DEFAULT_BLOCK_SIZE,
+                                                              job->mapped.size() - offset);
+                                std::ostringstream os;
+                                compress_payload_from_data(job->mapped.data() + offset, len, os);
+                                job->blocks[i] = os.str();
+                                // The last block to finish writes the container.
+                                if (job->remaining.fetch_sub(1) == 1 &&
+                                    !write_batch_container(*job)) {
+                                    job->batchOk->store(false);
+                                }
+                            });
+                        }
+                    });
+                    continue;
+                }
+                // Mapping unavailable: fall through to the whole-file task.
+            }
+            pool.submit([entry, &ok] {
+                if (!compress_file(entry.input, entry.output)) {
+                    ok.store(false);
+                }
+            });
+        }
+
+        pool.wait_idle();
+    }
+    stats_add("files", static_cast<double>(entries.size()));
+    stats_add("split_files", static_cast<double>(splitFiles));
+    stats_add("pool_threads", static_cast<double>(poolThreads));
+    return ok.load();
+}
+
+// Blocks are self-contained, so decode parallelizes the same way encode
+// does: records are read in order, payloads decoded on the thread pool,
+// and results written back in order through a bounded window.
+static bool decompress_file_blocks(std::istream& in, std::ostream& out, unsigned threadCount) {
+    StatsSuspend statsSuspend;
+    uint32_t blockSize = 0;
+    if (!read_u32(in, blockSize)) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+    }
+
+    ThreadPool pool(threadCount);
+    using BlockResult = std::pair<bool, std::string>;
+    std::deque<std::future<BlockResult>> pending;
+    const size_t window = static_cast<size_t>(threadCount) * 4;
+
+    auto submit_block = [&pool](std::function<BlockResult()> fn) {
+        auto task = std::make_shared<std::packaged_task<BlockResult()>>(std::move(fn));
+        std::future<BlockResult> fut = task->get_future();
+        pool.submit([task] { (*task)(); });
+        return fut;
+    };
+
+    auto write_front = [&]() -> bool {
+        BlockResult block = pending.front().get();
+        pending.pop_front();
+        if (!block.first) {
+            return false;
+        }
+        out.write(block.second.data(), static_cast<std::streamsize>(block.second.size()));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        return true;
+    };
+
+    for (;;) {
+        uint32_t rawSize = 0;
+        uint32_t compSize = 0;
+        if (!read_u32(in, rawSize) || !read_u32(in, compSize)) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        if (rawSize == 0 && compSize == 0) {
+            break;
+        }
+        auto payload = std::make_shared<std::string>(compSize, '\0');
+        in.read(&(*payload)[0], static_cast<std::streamsize>(compSize));
+        if (!in) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        pending.push_back(submit_block([payload]() -> BlockResult {
+            std::istringstream ps(*payload);
+            std::ostringstream os;
+            bool ok = decompress_payload(ps, os);
+            return BlockResult(ok, os.str());
+        }));
+        if (pending.size() >= window && !write_front()) {
+            return false;
+        }
+    }
+
+    while (!pending.empty()) {
+        if (!write_front()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Serves one byte range of the uncompressed stream from a blocked
+// container. The footer index (when present) jumps straight to the block
+// covering the range start; pre-index files fall back to hopping the
+// record headers, which still skips the payload decode for every block
+// before the range.
+static bool decompress_file_range(const std::string& inputPath, const std::string& outputPath,
+                                  uint64_t offset, uint64_t length) {
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || magic[0] != 'A' || magic[1] != 'E' || magic[2] != 'B' || magic[3] != 'K') {
+        std::cerr << "Range decode requires a blocked (AEBK) file\n";
+        return false;
+    }
+    uint32_t blockSize = 0;
+    if (!read_u32(in, blockSize)) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+
+    std::vector<codec_core::BlockIndexEntry> index;
+    bool haveIndex = codec_core::read_block_index(in, index);
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    uint64_t rawPos = 0;
+    std::streamoff dataStart = 8;
+    if (haveIndex) {
+        auto it = std::upper_bound(
+            index.begin(), index.end(), offset,
+            [](uint64_t v, const codec_core::BlockIndexEntry& e) { return v < e.rawOffset; });
+        if (it != index.begin()) {
+            --it;
+        }
+        dataStart = static_cast<std::streamoff>(it->compOffset);
+        rawPos = it->rawOffset;
+    }
+    in.clear();
+    in.seekg(dataStart);
+
+    uint64_t end = offset + length;
+    while (rawPos < end) {
+        uint32_t rawSize = 0;
+        uint32_t compSize = 0;
+        if (!read_u32(in, rawSize) || !read_u32(in, compSize)) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        if (rawSize == 0 && compSize == 0) {
+            break;
+        }
+        if (rawPos + rawSize <= offset) {
+            in.seekg(static_cast<std::streamoff>(compSize), std::ios::cur);
+            rawPos += rawSize;
+            continue;
+        }
+        std::string payload(compSize, '\0');
+        in.read(&payload[0], static_cast<std::streamsize>(compSize));
+        if (!in) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        std::istringstream ps(payload);
+        std::ostringstream os;
+        if (!decompress_payload(ps, os)) {
+            return false;
+        }
+        std::string blockData = os.str();
+        if (blockData.size() != rawSize) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        uint64_t from = offset > rawPos ? offset - rawPos : 0;
+        uint64_t to = std::min<uint64_t>(rawSize, end - rawPos);
+        out.write(blockData.data() + from, static_cast<std::streamsize>(to - from));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        rawPos += rawSize;
+    }
+    return static_cast<bool>(out);
+}
+
+static bool decompress_file(const std::string& inputPath, const std::string& outputPath,
+                            unsigned threadCount = 0) {
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || magic[0] != 'A' || magic[1] != 'E') {
+        std::cerr << "Invalid input file format\n";
+        return false;
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    if (magic[2] == 'N' && magic[3] == 'C') {
+        return decompress_payload(in, out);
+    }
+    if (magic[2] == 'C' && magic[3] == 'N') {
+        return decompress_payload(in, out, true);
+    }
+    if (magic[2] == 'B' && magic[3] == 'K') {
+        return decompress_file_blocks(in, out, threadCount);
+    }
+    if (magic[2] == 'A' && magic[3] == 'D') {
+        return decompress_file_adaptive(in, out);
+    }
+    if (magic[2] == 'O' && magic[3] == '1') {
+        return decompress_file_order1(in, out);
+    }
+    std::cerr << "Invalid input file format\n";
+    return false;
+}
+
+} // namespace arithmetic
+
+#ifndef ENCODING_NO_MAIN
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stats") {
+            arithmetic::g_stats_enabled = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    bool shortMode = !args.empty() && (args[0] == "list-archive" || args[0] == "encode-many");
+    if (args.size() < 2 || (args.size() < 3 && !shortMode)) {
+        std::cerr << "Usage: " << argv[0] << " encode|encode-compact|encode-pipeline|decode input output [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-blocks input output [block_size] [threads] [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-adaptive|encode-order1 input output [--stats]\n";
+        std::cerr << "       " << argv[0] << " decode input output [threads] [--stats]\n";
+        std::cerr << "       " << argv[0] << " decode-range input output offset length [--stats]\n";
+        std::cerr << "       " << argv[0] << " train input dict [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-preset|decode-preset input output dict [input output ...] [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-archive archive member [member ...] [--stats]\n";
+        std::cerr << "       " << argv[0] << " list-archive archive [--stats]\n";
+        std::cerr << "       " << argv[0] << " decode-archive archive output_dir [member] [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-many manifest [threads] [--stats]\n";
+        return 1;
+    }
+    std::string mode = args[0];
+    std::string inputPath = args[1];
+    std::string outputPath = args.size() > 2 ? args[2] : std::string();
+
+    bool ok = true;
+    double t0 = codec_core::now_ms();
+
+    if (mode == "encode" && args.size() == 3) {
+        ok = arithmetic::compress_file(inputPath, outputPath);
+    } else if (mode == "encode-compact" && args.size() == 3) {
+        ok = arithmetic::compress_file_compact(inputPath, outputPath);
+    } else if (mode == "encode-pipeline" && args.size() == 3) {
+        ok = arithmetic::compress_file_pipelined(inputPath, outputPath);
+    } else if (mode == "encode-blocks") {
+        uint32_t blockSize = arithmetic::DEFAULT_BLOCK_SIZE;
+        unsigned threads = 0;
+        if (args.size() >= 4) {
+            blockSize = static_cast<uint32_t>(std::stoul(args[3]));
+        }
+        if (args.size() >= 5) {
+            threads = static_cast<unsigned>(std::stoul(args[4]));
+        }
+        ok = arithmetic::compress_file_blocks(inputPath, outputPath, blockSize, threads);
+    } else if (mode == "encode-adaptive" && args.size() == 3) {
+        ok = arithmetic::compress_file_adaptive(inputPath, outputPath);
+    } else if (mode == "encode-order1" && args.size() == 3) {
+        ok = arithmetic::compress_file_order1(inputPath, outputPath);
+    } else if (mode == "train" && args.size() == 3) {
+        ok = arithmetic::train_dictionary(inputPath, outputPath);
+    } else if ((mode == "encode-preset" || mode == "decode-preset") &&
+               args.size() >= 4 && args.size() % 2 == 0) {
+        // The dictionary tables are built once here and reused for every
+        // input/output pair that follows.
+        bool encode = mode == "encode-preset";
+        arithmetic::PresetCodec preset;
+        ok = arithmetic::load_preset(args[3], preset);
+        if (ok) {
+            ok = encode ? arithmetic::compress_file_preset(preset, inputPath, outputPath)
+                        : arithmetic::decompress_file_preset(preset, inputPath, outputPath);
+        }
+        for (size_t i = 4; ok && i + 1 < args.size(); i += 2) {
+            ok = encode ? arithmetic::compress_file_preset(preset, args[i], args[i + 1])
+                        : arithmetic::decompress_file_preset(preset, args[i], args[i + 1]);
+        }
+    } else if (mode == "decode" && (args.size() == 3 || args.size() == 4)) {
+        unsigned threads = 0;
+        if (args.size() == 4) {
+            threads = static_cast<unsigned>(std::stoul(args[3]));
+        }
+        ok = arithmetic::decompress_file(inputPath, outputPath, threads);
+    } else if (mode == "decode-range" && args.size() == 5) {
+        ok = arithmetic::decompress_file_range(inputPath, outputPath,
+                                               std::stoull(args[3]), std::stoull(args[4]));
+    } else if (mode == "encode-archive" && args.size() >= 3) {
+        std::vector<std::string> members(args.begin() + 2, args.end());
+        ok = arithmetic::create_archive(inputPath, members);
+    } else if (mode == "list-archive" && args.size() == 2) {
+        ok = arithmetic::list_archive(inputPath);
+    } else if (mode == "decode-archive" && (args.size() == 3 || args.size() == 4)) {
+        ok = arithmetic::extract_archive(inputPath, outputPath,
+                                         args.size() == 4 ? args[3] : std::string());
+    } else if (mode == "encode-many" && (args.size() == 2 || args.size() == 3)) {
+        unsigned threads = args.size() == 3 ? static_cast<unsigned>(std::stoul(args[2])) : 0;
+        ok = arithmetic::compress_many(inputPath, threads);
+    } else {
+        std::cerr << "Unknown mode\n";
+        return 1;
+    }
+
+    if (arithmetic::g_stats_enabled) {
+        double totalMs = codec_core::now_ms() - t0;
+        uint64_t bytesIn = codec_core::file_size(inputPath);
+        uint64_t bytesOut = codec_core::file_size(outputPath);
+        uint64_t symbols = mode == "decode" ? bytesOut : bytesIn;
+        std::cerr << "STATS tool=arithmetic mode=" << mode
+                  << " ok=" << (ok ? 1 : 0)
+                  << " bytes_in=" << bytesIn
+                  << " bytes_out=" << bytesOut
+                  << " total_ms=" << totalMs
+                  << " symbols_per_s=" << (totalMs > 0.0 ? static_cast<double>(symbols) / (totalMs / 1000.0) : 0.0)
+                  << arithmetic::g_stats.str() << "\n";
     }
 
     return ok ? 0 : 1;
 }
+#endif // ENCODING_NO_MAIN
@@ -0,0 +1,441 @@
+// In-process microbenchmarks for the four C++ codecs. The per-codec CLIs
+// are timed end to end by huffman/benchmark/bench.py through subprocess,
+// which buries small effects under process startup and filesystem noise;
+// this driver calls the codec payload routines directly on in-memory
+// buffers, with a warm-up pass and repeated timed runs per configuration.
+//
+// Each tool's main() is compiled out via ENCODING_NO_MAIN so all four
+// translation units can be included here and benchmarked from one binary:
+//   g++ -std=c++17 -O2 benchmark/cpp/main.cpp -o bench_cpp
+#define ENCODING_NO_MAIN
+#include "../../huffman/cpp/main.cpp"
+#include "../../arithmetic/cpp/main.cpp"
+#include "../../range/cpp/main.cpp"
+#include "../../Run-Length/cpp/main.cpp"
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <random>
+
+namespace bench {
+
+// Synthetic inputs covering the entropy range the codecs see in practice:
+// incompressible noise, skewed text-like bytes, run-heavy telemetry, and
+// all-zero data.
+static std::vector<uint8_t> make_input(const std::string& profile, size_t size) {
+    std::vector<uint8_t> data(size);
+    std::mt19937 rng(12345);
+    if (profile == "random") {
+        for (size_t i = 0; i < size; i++) {
+            data[i] = static_cast<uint8_t>(rng());
+        }
+    } else if (profile == "text") {
+        static const char alphabet[] =
+            "eeeeeeeeeeeetttttttttaaaaaaaaoooooooiiiiiiinnnnnnnsssssshhhhhh"
+            "rrrrrddddlllcccuuummmwwwffggyyppbbvkjxqz      \n.,";
+        std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+        for (size_t i = 0; i < size; i++) {
+            data[i] = static_cast<uint8_t>(alphabet[pick(rng)]);
+        }
+    } else if (profile == "runs") {
+        std::uniform_int_distribution<uint32_t> length(1, 256);
+        size_t i = 0;
+        while (i < size) {
+            uint8_t value = static_cast<uint8_t>(rng());
+            size_t runLen = std::min<size_t>(length(rng), size - i);
+            std::memset(data.data() + i, value, runLen);
+            i += runLen;
+        }
+    } else {
+        // "zeros": vector is already zero-filled.
+    }
+    return data;
+}
+
+struct Stats {
+    double meanMiBps;
+    double minMiBps;
+    double maxMiBps;
+    double meanMs;
+};
+
+// Runs `fn` once for warm-up and `reps` timed times; throughput is always
+// relative to the uncompressed byte count so encode and decode compare.
+template <typename Fn>
+static Stats run_timed(size_t rawBytes, int reps, Fn fn) {
+    fn();
+    Stats st{0.0, 0.0, 0.0, 0.0};
+    double sumSec = 0.0;
+    for (int r = 0; r < reps; r++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto stop = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(stop - start).count();
+        double mibps = sec > 0.0 ? (static_cast<double>(rawBytes) / (1024.0 * 1024.0)) / sec : 0.0;
+        if (r == 0 || mibps < st.minMiBps) {
+            st.minMiBps = mibps;
+        }
+        if (r == 0 || mibps > st.maxMiBps) {
+            st.maxMiBps = mibps;
+        }
+        sumSec += sec;
+    }
+    st.meanMs = sumSec / reps * 1000.0;
+    st.meanMiBps = st.meanMs > 0.0
+        ? (static_cast<double>(rawBytes) / (1024.0 * 1024.0)) / (st.meanMs / 1000.0)
+        : 0.0;
+    return st;
+}
+
+static void report(const std::string& name, size_t size, const Stats& st, int reps) {
+    std::ostringstream label;
+    label << name << "/" << size;
+    std::cout << std::left << std::setw(40) << label.str()
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << st.meanMs << " ms"
+              << std::setw(10) << st.meanMiBps << " MiB/s"
+              << "  (reps=" << reps
+              << " min=" << st.minMiBps
+              << " max=" << st.maxMiBps << ")\n";
+}
+
+static void fail(const std::string& name) {
+    std::cerr << "Round-trip mismatch in " << name << " benchmark\n";
+    std::exit(1);
+}
+
+static void bench_profile(const std::string& profile, size_t size, int reps) {
+    std::vector<uint8_t> data = make_input(profile, size);
+
+    // Huffman: payload-level encode/decode (frequency table + bitstream).
+    {
+        std::ostringstream enc;
+        huffman::compress_payload_from_data(data.data(), data.size(), enc);
+        std::string encoded = enc.str();
+        {
+            std::istringstream in(encoded);
+            std::ostringstream out;
+            huffman::decompress_payload(in, out);
+            if (out.str().size() != data.size() ||
+                std::memcmp(out.str().data(), data.data(), data.size()) != 0) {
+                fail("huffman");
+            }
+        }
+        report("huffman/encode/" + profile, size, run_timed(size, reps, [&] {
+            std::ostringstream out;
+            huffman::compress_payload_from_data(data.data(), data.size(), out);
+        }), reps);
+        report("huffman/decode/" + profile, size, run_timed(size, reps, [&] {
+            std::istringstream in(encoded);
+            std::ostringstream out;
+            huffman::decompress_payload(in, out);
+        }), reps);
+    }
+
+    // Arithmetic: static-model payload encode/decode.
+    {
+        std::ostringstream enc;
+        arithmetic::compress_payload_from_data(data.data(), data.size(), enc);
+        std::string encoded = enc.str();
+        {
+            std::istringstream in(encoded);
+            std::ostringstream out;
+            arithmetic::decompress_payload(in, out);
+            if (out.str().size() != data.size() ||
+                std::memcmp(out.str().data(), data.data(), data.size()) != 0) {
+                fail("arithmetic");
+            }
+        }
+        report("arithmetic/encode/" + profile, size, run_timed(size, reps, [&] {
+            std::ostringstream out;
+            arithmetic::compress_payload_from_data(data.data(), data.size(), out);
+        }), reps);
+        report("arithmetic/decode/" + profile, size, run_timed(size, reps, [&] {
+            std::istringstream in(encoded);
+            std::ostringstream out;
+            arithmetic::decompress_payload(in, out);
+        }), reps);
+    }
+
+    // Range coder: whole-buffer encode/decode. Some run-heavy inputs
+    // trigger the coder's known interval collapse (its carryless renorm has
+    // no underflow handling); those configurations are reported and
+    // skipped rather than aborting the suite.
+    try {
+        std::vector<uint8_t> encoded = range_coder::encode(data);
+        if (range_coder::decode(encoded) != data) {
+            throw std::runtime_error("round-trip mismatch after interval collapse");
+        }
+        report("range/encode/" + profile, size, run_timed(size, reps, [&] {
+            range_coder::encode(data);
+        }), reps);
+        report("range/decode/" + profile, size, run_timed(size, reps, [&] {
+            range_coder::decode(encoded);
+        }), reps);
+    } catch (const std::exception& e) {
+        std::cout << "range/*/" << profile << "/" << size
+                  << "  skipped: " << e.what() << "\n";
+    }
+
+    // rANS: interleaved two-state coder.
+    {
+        std::vector<uint8_t> encoded = rans::encode(data);
+        if (rans::decode(encoded) != data) {
+            fail("rans");
+        }
+        report("rans/encode/" + profile, size, run_timed(size, reps, [&] {
+            rans::encode(data);
+        }), reps);
+        report("rans/decode/" + profile, size, run_timed(size, reps, [&] {
+            rans::decode(encoded);
+        }), reps);
+    }
+
+    // RLE v2: hybrid run/literal format. Decode drains through a /dev/null
+    // sink so the measurement stays on the codec, not on a growing buffer.
+    {
+        std::vector<uint8_t> enc;
+        rle2_encode_data(data.data(), data.size(), enc);
+        std::string encoded(enc.begin(), enc.end());
+        report("rle/encode/" + profile, size, run_timed(size, reps, [&] {
+            std::vector<uint8_t> out;
+            rle2_encode_data(data.data(), data.size(), out);
+        }), reps);
+        report("rle/decode/" + profile, size, run_timed(size, reps, [&] {
+            std::istringstream in(encoded);
+            char magic[4];
+            in.read(magic, 4);
+            DecodeSink sink("/dev/null", 0);
+            rle2_decode_stream(in, sink);
+        }), reps);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Corpus mode: instead of synthetic profiles, run every codec over the
+// regular files in a user-supplied directory (recursively) and report
+// per-codec encode/decode throughput, compression ratio, and p50/p99
+// per-file latency as one JSON document on stdout. This is the
+// apples-to-apples number for choosing a codec per data class: same
+// files, same process, no subprocess or page-cache noise.
+// ---------------------------------------------------------------------------
+
+// Nearest-rank percentile over per-file latencies.
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t idx = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(idx, values.size() - 1)];
+}
+
+struct CorpusCodecStats {
+    std::string name;
+    uint64_t files = 0;
+    uint64_t errors = 0;
+    uint64_t rawBytes = 0;
+    uint64_t encBytes = 0;
+    double encSec = 0.0;
+    double decSec = 0.0;
+    std::vector<double> encMs;
+    std::vector<double> decMs;
+};
+
+// Times `fn` with one warm-up pass and `reps` repetitions, returning the
+// best (steady-state) time in seconds.
+template <typename Fn>
+static double time_best(int reps, Fn fn) {
+    fn();
+    double best = 0.0;
+    for (int r = 0; r < reps; r++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto stop = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(stop - start).count();
+        if (r == 0 || sec < best) {
+            best = sec;
+        }
+    }
+    return best;
+}
+
+// Runs one codec over one file's bytes. `encode` returns the compressed
+// buffer; `decode` must reproduce `data` from it. Round-trip failures and
+// codec exceptions count as errors and leave the aggregates untouched.
+template <typename EncodeFn, typename DecodeFn>
+static void corpus_run_file(CorpusCodecStats& st, const std::vector<uint8_t>& data, int reps,
+                            EncodeFn encode, DecodeFn decode) {
+    try {
+        std::vector<uint8_t> encoded = encode();
+        std::vector<uint8_t> decoded = decode(encoded);
+        if (decoded != data) {
+            st.errors++;
+            return;
+        }
+        double encSec = time_best(reps, [&] { encode(); });
+        double decSec = time_best(reps, [&] { decode(encoded); });
+        st.files++;
+        st.rawBytes += data.size();
+        st.encBytes += encoded.size();
+        st.encSec += encSec;
+        st.decSec += decSec;
+        st.encMs.push_back(encSec * 1000.0);
+        st.decMs.push_back(decSec * 1000.0);
+    } catch (const std::exception&) {
+        st.errors++;
+    }
+}
+
+static void corpus_emit_json(const std::string& dir, int reps,
+                             const std::vector<CorpusCodecStats>& codecs) {
+    auto mibps = [](uint64_t bytes, double sec) {
+        return sec > 0.0 ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / sec : 0.0;
+    };
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "{\n  \"corpus\": \"" << dir << "\",\n  \"reps\": " << reps
+              << ",\n  \"codecs\": [\n";
+    for (size_t i = 0; i < codecs.size(); i++) {
+        const CorpusCodecStats& st = codecs[i];
+        double ratio = st.rawBytes > 0
+            ? static_cast<double>(st.encBytes) / static_cast<double>(st.rawBytes)
+            : 0.0;
+        std::cout << "    {\"name\": \"" << st.name << "\""
+                  << ", \"files\": " << st.files
+                  << ", \"errors\": " << st.errors
+                  << ", \"raw_bytes\": " << st.rawBytes
+                  << ", \"encoded_bytes\": " << st.encBytes
+                  << ", \"ratio\": " << ratio
+                  << ", \"encode_mibps\": " << mibps(st.rawBytes, st.encSec)
+                  << ", \"decode_mibps\": " << mibps(st.rawBytes, st.decSec)
+                  << ", \"encode_ms_p50\": " << percentile(st.encMs, 0.50)
+                  << ", \"encode_ms_p99\": " << percentile(st.encMs, 0.99)
+                  << ", \"decode_ms_p50\": " << percentile(st.decMs, 0.50)
+                  << ", \"decode_ms_p99\": " << percentile(st.decMs, 0.99)
+                  << "}" << (i + 1 < codecs.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}\n";
+}
+
+static int bench_corpus(const std::string& dir, int reps) {
+    std::vector<std::filesystem::path> paths;
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it(dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        if (it->is_regular_file(ec)) {
+            paths.push_back(it->path());
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "No regular files found under " << dir << "\n";
+        return 1;
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<CorpusCodecStats> codecs(5);
+    codecs[0].name = "huffman";
+    codecs[1].name = "arithmetic";
+    codecs[2].name = "range";
+    codecs[3].name = "rans";
+    codecs[4].name = "rle";
+
+    for (const auto& path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            continue;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+
+        corpus_run_file(codecs[0], data, reps,
+            [&] {
+                std::vector<uint8_t> out;
+                huffman::compress_buffer(data.data(), data.size(), out);
+                return out;
+            },
+            [&](const std::vector<uint8_t>& enc) {
+                std::vector<uint8_t> out;
+                if (!huffman::decompress_buffer(enc.data(), enc.size(), out)) {
+                    throw std::runtime_error("huffman decode failed");
+                }
+                return out;
+            });
+
+        corpus_run_file(codecs[1], data, reps,
+            [&] {
+                std::ostringstream out;
+                arithmetic::compress_payload_from_data(data.data(), data.size(), out);
+                std::string s = out.str();
+                return std::vector<uint8_t>(s.begin(), s.end());
+            },
+            [&](const std::vector<uint8_t>& enc) {
+                std::istringstream in2(std::string(enc.begin(), enc.end()));
+                std::ostringstream out;
+                if (!arithmetic::decompress_payload(in2, out)) {
+                    throw std::runtime_error("arithmetic decode failed");
+                }
+                std::string s = out.str();
+                return std::vector<uint8_t>(s.begin(), s.end());
+            });
+
+        corpus_run_file(codecs[2], data, reps,
+            [&] { return range_coder::encode(data); },
+            [&](const std::vector<uint8_t>& enc) { return range_coder::decode(enc); });
+
+        corpus_run_file(codecs[3], data, reps,
+            [&] { return rans::encode(data); },
+            [&](const std::vector<uint8_t>& enc) { return rans::decode(enc); });
+
+        corpus_run_file(codecs[4], data, reps,
+            [&] {
+                std::vector<uint8_t> out;
+                rle2_encode_data(data.data(), data.size(), out);
+                return out;
+            },
+            [&](const std::vector<uint8_t>& enc) {
+                std::vector<uint8_t> out;
+                if (!rle_decode_data(enc.data(), enc.size(), out)) {
+                    throw std::runtime_error("rle decode failed");
+                }
+                return out;
+            });
+    }
+
+    corpus_emit_json(dir, reps, codecs);
+    return 0;
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) {
+    int reps = 5;
+    std::string corpusDir;
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--reps" && i + 1 < argc) {
+            reps = std::stoi(argv[++i]);
+        } else if (arg == "--corpus" && i + 1 < argc) {
+            corpusDir = argv[++i];
+        } else {
+            sizes.push_back(static_cast<size_t>(std::stoull(arg)));
+        }
+    }
+    if (!corpusDir.empty()) {
+        return bench::bench_corpus(corpusDir, reps);
+    }
+    if (sizes.empty()) {
+        sizes.push_back(1u << 20);
+        sizes.push_back(1u << 23);
+    }
+
+    static const char* profiles[] = {"random", "text", "runs", "zeros"};
+    for (size_t size : sizes) {
+        for (const char* profile : profiles) {
+            bench::bench_profile(profile, size, reps);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,1112 @@
+// Shared core for the C++ codec tools (huffman, arithmetic, range, RLE).
+// Everything here is header-only on purpose: the bit I/O and table kernels
+// sit inside each codec's inner loop, and keeping them in the header lets
+// the compiler inline them into every caller. Each tool still builds as a
+// standalone main.cpp (g++ ... main.cpp), so there is no library target to
+// link — this header is the whole dependency.
+#ifndef CODEC_CORE_HPP
+#define CODEC_CORE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CODEC_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace codec_core {
+
+// Read-only view of an input file. Memory-maps the file where supported so
+// the histogram and encode passes iterate over a plain byte span and share
+// one mapping; when mapping is unavailable callers fall back to streaming.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : data_(nullptr), size_(0), mapped_(false) {
+#ifdef CODEC_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < 0) {
+            ::close(fd);
+            return;
+        }
+        if (st.st_size == 0) {
+            ::close(fd);
+            mapped_ = true;
+            return;
+        }
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return;
+        }
+        data_ = static_cast<const uint8_t*>(p);
+        size_ = static_cast<size_t>(st.st_size);
+        mapped_ = true;
+#else
+        (void)path;
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef CODEC_HAVE_MMAP
+        if (data_) {
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool mapped() const { return mapped_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    bool mapped_;
+};
+
+// Fixed-size worker pool used by the block-parallel encode modes.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount) : stop_(false) {
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+        for (unsigned i = 0; i < threadCount; i++) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (std::thread& t : workers_) {
+            t.join();
+        }
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+};
+
+// Work-stealing worker pool for batch jobs over many independent files.
+// Each worker owns a deque: tasks submitted from inside a worker land on
+// that worker's own deque and are popped LIFO (newest first, cache-warm),
+// while idle workers steal FIFO from the other end of a victim's deque
+// (oldest first, typically the largest remaining unit). External submits
+// are spread round-robin. Unlike ThreadPool's single shared queue, a task
+// here may safely submit subtasks — a large file's block tasks go onto the
+// spawning worker's deque and are stolen by whoever runs dry — so one
+// straggler file cannot pin the batch on a single core.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threadCount) : outstanding_(0), nextWorker_(0), stop_(false) {
+        if (threadCount == 0) {
+            threadCount = std::thread::hardware_concurrency();
+            if (threadCount == 0) {
+                threadCount = 1;
+            }
+        }
+        for (unsigned i = 0; i < threadCount; i++) {
+            queues_.emplace_back(new WorkerQueue());
+        }
+        for (unsigned i = 0; i < threadCount; i++) {
+            workers_.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+        }
+        sleepCv_.notify_all();
+        for (std::thread& t : workers_) {
+            t.join();
+        }
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    void submit(std::function<void()> task) {
+        size_t target;
+        if (t_pool == this) {
+            target = t_index;
+        } else {
+            target = nextWorker_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        }
+        outstanding_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+            queues_[target]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+        }
+        sleepCv_.notify_one();
+    }
+
+    // Blocks until every submitted task (including subtasks spawned while
+    // waiting) has finished. Call only from outside the pool.
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepCv_.wait(lock, [this] { return outstanding_.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    struct WorkerQueue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    bool take(size_t self, std::function<void()>& task) {
+        // Own deque from the back first, then steal from the front of the
+        // others, scanning from the next worker round.
+        {
+            std::lock_guard<std::mutex> lock(queues_[self]->mutex);
+            if (!queues_[self]->tasks.empty()) {
+                task = std::move(queues_[self]->tasks.back());
+                queues_[self]->tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t hop = 1; hop < queues_.size(); hop++) {
+            size_t victim = (self + hop) % queues_.size();
+            std::lock_guard<std::mutex> lock(queues_[victim]->mutex);
+            if (!queues_[victim]->tasks.empty()) {
+                task = std::move(queues_[victim]->tasks.front());
+                queues_[victim]->tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t index) {
+        t_pool = this;
+        t_index = index;
+        for (;;) {
+            std::function<void()> task;
+            if (take(index, task)) {
+                task();
+                if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(sleepMutex_);
+                    sleepCv_.notify_all();
+                }
+                continue;
+            }
+            // Re-check under the sleep lock: submit() touches it after the
+            // push, so either the new task is visible here or the notify
+            // lands after we start waiting.
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            if (stop_) {
+                return;
+            }
+            if (take(index, task)) {
+                lock.unlock();
+                task();
+                if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> relock(sleepMutex_);
+                    sleepCv_.notify_all();
+                }
+                continue;
+            }
+            sleepCv_.wait(lock);
+        }
+    }
+
+    static thread_local WorkStealingPool* t_pool;
+    static thread_local size_t t_index;
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> outstanding_;
+    std::atomic<size_t> nextWorker_;
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCv_;
+    bool stop_;
+};
+
+inline thread_local WorkStealingPool* WorkStealingPool::t_pool = nullptr;
+inline thread_local size_t WorkStealingPool::t_index = 0;
+
+// Bounded buffer handoff between pipeline stages: the producer blocks
+// once `capacity` buffers are in flight, the consumer blocks on empty,
+// and close() lets the consumer drain what remains and then stop. With
+// capacity 2 this is classic double buffering — one buffer being filled
+// while the other is consumed.
+class BufferQueue {
+public:
+    explicit BufferQueue(size_t capacity) : capacity_(capacity), closed_(false) {}
+
+    void push(std::vector<char>&& buf) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notFull_.wait(lock, [this] { return buffers_.size() < capacity_; });
+            buffers_.push_back(std::move(buf));
+        }
+        notEmpty_.notify_one();
+    }
+
+    // Returns false once the queue is closed and drained.
+    bool pop(std::vector<char>& buf) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || !buffers_.empty(); });
+        if (buffers_.empty()) {
+            return false;
+        }
+        buf = std::move(buffers_.front());
+        buffers_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::deque<std::vector<char>> buffers_;
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    size_t capacity_;
+    bool closed_;
+};
+
+// std::streambuf that fills fixed-size buffers and hands each completed
+// one to a BufferQueue, so a writer thread can drain output while the
+// codec keeps running. Callers must flush the wrapping ostream before
+// closing the queue to push the final partial buffer.
+class QueueStreamBuf : public std::streambuf {
+public:
+    QueueStreamBuf(BufferQueue& queue, size_t bufferSize)
+        : queue_(queue), bufferSize_(bufferSize), buf_(bufferSize) {
+        setp(buf_.data(), buf_.data() + buf_.size());
+    }
+
+protected:
+    int overflow(int ch) override {
+        hand_off();
+        if (ch != traits_type::eof()) {
+            *pptr() = static_cast<char>(ch);
+            pbump(1);
+        }
+        return ch;
+    }
+
+    int sync() override {
+        hand_off();
+        return 0;
+    }
+
+private:
+    void hand_off() {
+        size_t used = static_cast<size_t>(pptr() - pbase());
+        if (used > 0) {
+            buf_.resize(used);
+            queue_.push(std::move(buf_));
+            buf_.assign(bufferSize_, 0);
+        }
+        setp(buf_.data(), buf_.data() + buf_.size());
+    }
+
+    BufferQueue& queue_;
+    size_t bufferSize_;
+    std::vector<char> buf_;
+};
+
+// Bit I/O over a 64-bit accumulator with a 64 KiB byte buffer, so the hot
+// paths touch the underlying iostream only once per buffer instead of once
+// per byte.
+class BitWriter {
+public:
+    explicit BitWriter(std::ostream& s) : stream(s), bitBuffer(0), bitCount(0) {
+        buffer.reserve(BUFFER_SIZE);
+    }
+
+    void write_bit(int bit) {
+        write_bits(static_cast<uint64_t>(bit & 1), 1);
+    }
+
+    // Appends the low `count` bits of `value`, MSB first. count must be <= 57.
+    void write_bits(uint64_t value, int count) {
+        bitBuffer = (bitBuffer << count) | (value & ((1ull << count) - 1));
+        bitCount += count;
+        while (bitCount >= 8) {
+            bitCount -= 8;
+            buffer.push_back(static_cast<uint8_t>(bitBuffer >> bitCount));
+            if (buffer.size() == BUFFER_SIZE) {
+                flush_buffer();
+            }
+        }
+    }
+
+    void flush() {
+        if (bitCount > 0) {
+            buffer.push_back(static_cast<uint8_t>(bitBuffer << (8 - bitCount)));
+            bitCount = 0;
+            bitBuffer = 0;
+        }
+        flush_buffer();
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1u << 16;
+
+    void flush_buffer() {
+        if (!buffer.empty()) {
+            stream.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+
+    std::ostream& stream;
+    std::vector<uint8_t> buffer;
+    uint64_t bitBuffer;
+    int bitCount;
+};
+
+class BitReader {
+public:
+    explicit BitReader(std::istream& s)
+        : stream(s), buffer(BUFFER_SIZE), pos(0), end(0), bitBuffer(0), bitCount(0), reachedEof(false) {}
+
+    int read_bit() {
+        uint32_t bit = peek_bits(1);
+        consume_bits(1);
+        return static_cast<int>(bit);
+    }
+
+    // Reads the next `count` bits (MSB first). Bits past the end of the
+    // stream read as 0. count must be <= 24.
+    uint32_t read_bits(int count) {
+        uint32_t bits = peek_bits(count);
+        consume_bits(count);
+        return bits;
+    }
+
+    // Returns the next `count` bits (MSB first) without consuming them.
+    // Bits past the end of the stream read as 0. count must be <= 24.
+    uint32_t peek_bits(int count) {
+        fill();
+        if (bitCount >= count) {
+            return static_cast<uint32_t>(bitBuffer >> (bitCount - count)) & ((1u << count) - 1);
+        }
+        uint32_t bits = static_cast<uint32_t>(bitBuffer & ((1ull << bitCount) - 1));
+        return bits << (count - bitCount);
+    }
+
+    void consume_bits(int count) {
+        if (bitCount >= count) {
+            bitCount -= count;
+        } else {
+            bitCount = 0;
+        }
+    }
+
+    bool eof() const {
+        return reachedEof && pos == end && bitCount == 0;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1u << 16;
+
+    void fill() {
+        while (bitCount <= 56) {
+            if (pos == end) {
+                if (reachedEof) {
+                    break;
+                }
+                stream.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+                end = static_cast<size_t>(stream.gcount());
+                pos = 0;
+                if (end == 0) {
+                    reachedEof = true;
+                    break;
+                }
+                if (end < buffer.size()) {
+                    reachedEof = true;
+                }
+            }
+            bitBuffer = (bitBuffer << 8) | static_cast<uint64_t>(buffer[pos++]);
+            bitCount += 8;
+        }
+    }
+
+    std::istream& stream;
+    std::vector<uint8_t> buffer;
+    size_t pos;
+    size_t end;
+    uint64_t bitBuffer;
+    int bitCount;
+    bool reachedEof;
+};
+
+// In-memory counterparts of BitWriter/BitReader with the same method
+// surface, for callers that hold the whole payload in a buffer and want
+// no iostreams on the path. BufferBitWriter appends to a caller-owned
+// vector; BufferBitReader walks a caller-owned byte span.
+class BufferBitWriter {
+public:
+    explicit BufferBitWriter(std::vector<uint8_t>& out)
+        : out_(out), bitBuffer(0), bitCount(0) {}
+
+    void write_bit(int bit) {
+        write_bits(static_cast<uint64_t>(bit & 1), 1);
+    }
+
+    // Appends the low `count` bits of `value`, MSB first. count must be <= 57.
+    void write_bits(uint64_t value, int count) {
+        bitBuffer = (bitBuffer << count) | (value & ((1ull << count) - 1));
+        bitCount += count;
+        while (bitCount >= 8) {
+            bitCount -= 8;
+            out_.push_back(static_cast<uint8_t>(bitBuffer >> bitCount));
+        }
+    }
+
+    void flush() {
+        if (bitCount > 0) {
+            out_.push_back(static_cast<uint8_t>(bitBuffer << (8 - bitCount)));
+            bitCount = 0;
+            bitBuffer = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t bitBuffer;
+    int bitCount;
+};
+
+class BufferBitReader {
+public:
+    BufferBitReader(const uint8_t* data, size_t size)
+        : data_(data), size_(size), pos(0), bitBuffer(0), bitCount(0) {}
+
+    int read_bit() {
+        uint32_t bit = peek_bits(1);
+        consume_bits(1);
+        return static_cast<int>(bit);
+    }
+
+    // Reads the next `count` bits (MSB first). Bits past the end of the
+    // span read as 0. count must be <= 24.
+    uint32_t read_bits(int count) {
+        uint32_t bits = peek_bits(count);
+        consume_bits(count);
+        return bits;
+    }
+
+    // Returns the next `count` bits (MSB first) without consuming them.
+    // Bits past the end of the span read as 0. count must be <= 24.
+    uint32_t peek_bits(int count) {
+        fill();
+        if (bitCount >= count) {
+            return static_cast<uint32_t>(bitBuffer >> (bitCount - count)) & ((1u << count) - 1);
+        }
+        uint32_t bits = static_cast<uint32_t>(bitBuffer & ((1ull << bitCount) - 1));
+        return bits << (count - bitCount);
+    }
+
+    void consume_bits(int count) {
+        if (bitCount >= count) {
+            bitCount -= count;
+        } else {
+            bitCount = 0;
+        }
+    }
+
+    bool eof() const {
+        return pos == size_ && bitCount == 0;
+    }
+
+private:
+    void fill() {
+        while (bitCount <= 56 && pos < size_) {
+            bitBuffer = (bitBuffer << 8) | static_cast<uint64_t>(data_[pos++]);
+            bitCount += 8;
+        }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos;
+    uint64_t bitBuffer;
+    int bitCount;
+};
+
+// Histogram kernel: four interleaved counter banks and 8-byte loads, so
+// back-to-back increments of the same byte value hit different counters
+// instead of serializing on store-to-load forwarding. `counts` must hold
+// 4 * 256 zero-initialized entries; reduce with histogram_reduce.
+inline void histogram_add(const uint8_t* data, size_t size, uint32_t* counts) {
+    uint32_t* c0 = counts;
+    uint32_t* c1 = counts + 256;
+    uint32_t* c2 = counts + 512;
+    uint32_t* c3 = counts + 768;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, sizeof(w));
+        c0[w & 0xFF]++;
+        c1[(w >> 8) & 0xFF]++;
+        c2[(w >> 16) & 0xFF]++;
+        c3[(w >> 24) & 0xFF]++;
+        c0[(w >> 32) & 0xFF]++;
+        c1[(w >> 40) & 0xFF]++;
+        c2[(w >> 48) & 0xFF]++;
+        c3[w >> 56]++;
+    }
+    for (; i < size; i++) {
+        c0[data[i]]++;
+    }
+}
+
+inline void histogram_reduce(const uint32_t* counts, std::vector<uint32_t>& freq) {
+    for (uint32_t s = 0; s < 256; s++) {
+        freq[s] = counts[s] + counts[s + 256] + counts[s + 512] + counts[s + 768];
+    }
+}
+
+// Scales `freq` down so its sum stays within `maxTotal`, keeping every
+// nonzero entry nonzero. An all-zero table degenerates to uniform.
+inline void scale_frequencies(std::vector<uint32_t>& freq, uint32_t maxTotal) {
+    uint64_t total = 0;
+    for (uint32_t f : freq) {
+        total += f;
+    }
+    if (total == 0) {
+        for (size_t i = 0; i < freq.size(); i++) {
+            freq[i] = 1;
+        }
+        return;
+    }
+    if (total <= maxTotal) {
+        return;
+    }
+    uint64_t newTotal = 0;
+    for (size_t i = 0; i < freq.size(); i++) {
+        if (freq[i] == 0) {
+            continue;
+        }
+        uint64_t scaled = static_cast<uint64_t>(freq[i]) * maxTotal / total;
+        if (scaled == 0) {
+            scaled = 1;
+        }
+        freq[i] = static_cast<uint32_t>(scaled);
+        newTotal += scaled;
+    }
+    if (newTotal == 0) {
+        uint32_t base = maxTotal / static_cast<uint32_t>(freq.size());
+        if (base == 0) {
+            base = 1;
+        }
+        for (size_t i = 0; i < freq.size(); i++) {
+            freq[i] = base;
+        }
+    }
+}
+
+inline std::vector<uint32_t> build_cumulative(const std::vector<uint32_t>& freq) {
+    std::vector<uint32_t> cumulative(freq.size() + 1, 0);
+    for (size_t i = 0; i < freq.size(); i++) {
+        cumulative[i + 1] = cumulative[i] + freq[i];
+    }
+    if (cumulative.back() == 0) {
+        for (size_t i = 0; i < freq.size(); i++) {
+            cumulative[i + 1] = static_cast<uint32_t>(i + 1);
+        }
+    }
+    return cumulative;
+}
+
+// Quantized symbol lookup for decode: slot[v >> shift] holds the first
+// symbol whose interval can contain the scaled value v, so finding the
+// symbol is one table index plus at most a few linear steps instead of an
+// 8-step binary search with unpredictable branches.
+struct SymbolLookup {
+    std::vector<uint16_t> slot;
+    uint32_t shift;
+};
+
+inline SymbolLookup build_symbol_lookup(const std::vector<uint32_t>& cumulative) {
+    static const uint32_t TABLE_BITS = 12;
+    SymbolLookup lut;
+    uint32_t total = cumulative.back();
+    uint32_t bits = 0;
+    while ((1u << bits) < total) {
+        bits++;
+    }
+    lut.shift = bits > TABLE_BITS ? bits - TABLE_BITS : 0;
+    size_t slots = (static_cast<size_t>(total - 1) >> lut.shift) + 1;
+    lut.slot.assign(slots, 0);
+    uint32_t s = 0;
+    for (size_t i = 0; i < slots; i++) {
+        uint32_t v = static_cast<uint32_t>(i) << lut.shift;
+        while (cumulative[s + 1] <= v) {
+            s++;
+        }
+        lut.slot[i] = static_cast<uint16_t>(s);
+    }
+    return lut;
+}
+
+// Little-endian 32-bit helpers, stream flavour. Used for the container
+// record headers (block/chunk sizes).
+inline void write_u32(std::ostream& out, uint32_t v) {
+    uint8_t buf[4];
+    buf[0] = static_cast<uint8_t>(v & 0xFF);
+    buf[1] = static_cast<uint8_t>((v >> 8) & 0xFF);
+    buf[2] = static_cast<uint8_t>((v >> 16) & 0xFF);
+    buf[3] = static_cast<uint8_t>((v >> 24) & 0xFF);
+    out.write(reinterpret_cast<const char*>(buf), 4);
+}
+
+inline bool read_u32(std::istream& in, uint32_t& v) {
+    uint8_t buf[4];
+    in.read(reinterpret_cast<char*>(buf), 4);
+    if (in.gcount() != 4) {
+        return false;
+    }
+    v = static_cast<uint32_t>(buf[0]) |
+        (static_cast<uint32_t>(buf[1]) << 8) |
+        (static_cast<uint32_t>(buf[2]) << 16) |
+        (static_cast<uint32_t>(buf[3]) << 24);
+    return true;
+}
+
+// Little-endian 32-bit helpers, in-memory flavour.
+inline void write_u32_le(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v & 0xFF));
+    out.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
+    out.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
+    out.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
+}
+
+inline bool read_u32_le(const std::vector<uint8_t>& in, size_t& pos, uint32_t& v) {
+    if (pos + 4 > in.size()) {
+        return false;
+    }
+    v = static_cast<uint32_t>(in[pos]) |
+        (static_cast<uint32_t>(in[pos + 1]) << 8) |
+        (static_cast<uint32_t>(in[pos + 2]) << 16) |
+        (static_cast<uint32_t>(in[pos + 3]) << 24);
+    pos += 4;
+    return true;
+}
+
+// Monotonic wall-clock sample in milliseconds, for the tools' opt-in
+// --stats instrumentation.
+inline double now_ms() {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Size of a file in bytes, or 0 if it cannot be opened.
+inline uint64_t file_size(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return 0;
+    }
+    std::streamoff size = in.tellg();
+    return size > 0 ? static_cast<uint64_t>(size) : 0;
+}
+
+// One batch job: input path and where its encoded output goes.
+struct ManifestEntry {
+    std::string input;
+    std::string output;
+};
+
+// Manifest format for the batch encode modes: one job per line as
+// "input output" separated by whitespace; blank lines and lines starting
+// with '#' are skipped.
+inline bool read_manifest(const std::string& path, std::vector<ManifestEntry>& entries) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    entries.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+        size_t split = line.find_first_of(" \t", begin);
+        if (split == std::string::npos) {
+            return false;
+        }
+        size_t second = line.find_first_not_of(" \t", split);
+        if (second == std::string::npos) {
+            return false;
+        }
+        size_t end = line.find_last_not_of(" \t\r");
+        ManifestEntry entry;
+        entry.input = line.substr(begin, split - begin);
+        entry.output = line.substr(second, end - second + 1);
+        entries.push_back(std::move(entry));
+    }
+    return !entries.empty();
+}
+
+// Frequency-table serialization shared by the huffman and arithmetic
+// headers: a 32-bit entry count followed by the raw 32-bit counts.
+inline void write_frequencies(std::ostream& out, const std::vector<uint32_t>& freq) {
+    write_u32(out, static_cast<uint32_t>(freq.size()));
+    for (uint32_t v : freq) {
+        write_u32(out, v);
+    }
+}
+
+inline bool read_frequencies(std::istream& in, std::vector<uint32_t>& freq, uint32_t expectedCount) {
+    uint32_t count = 0;
+    if (!read_u32(in, count)) {
+        std::cerr << "Failed to read frequency table\n";
+        return false;
+    }
+    if (count != expectedCount) {
+        std::cerr << "Bad frequency table size: " << count << "\n";
+        return false;
+    }
+    freq.assign(count, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        if (!read_u32(in, freq[i])) {
+            std::cerr << "Failed to read frequency table\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Little-endian 64-bit helpers for the block index footer offsets.
+inline void write_u64(std::ostream& out, uint64_t v) {
+    uint8_t buf[8];
+    for (int i = 0; i < 8; i++) {
+        buf[i] = static_cast<uint8_t>((v >> (8 * i)) & 0xFF);
+    }
+    out.write(reinterpret_cast<const char*>(buf), 8);
+}
+
+inline bool read_u64(std::istream& in, uint64_t& v) {
+    uint8_t buf[8];
+    in.read(reinterpret_cast<char*>(buf), 8);
+    if (in.gcount() != 8) {
+        return false;
+    }
+    v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= static_cast<uint64_t>(buf[i]) << (8 * i);
+    }
+    return true;
+}
+
+// Optional seekable index for the blocked containers, appended after the
+// zero/zero terminator record: one (compressed offset, uncompressed
+// offset) pair per block, then the entry count and a trailing "BKIX"
+// magic so a reader can probe for it from the end of the file. Decoders
+// that stop at the terminator never see the footer, which keeps indexed
+// files readable by older builds.
+struct BlockIndexEntry {
+    uint64_t compOffset;
+    uint64_t rawOffset;
+};
+
+inline void write_block_index(std::ostream& out, const std::vector<BlockIndexEntry>& index) {
+    for (const BlockIndexEntry& e : index) {
+        write_u64(out, e.compOffset);
+        write_u64(out, e.rawOffset);
+    }
+    write_u32(out, static_cast<uint32_t>(index.size()));
+    out.write("BKIX", 4);
+}
+
+// Probes the tail of a seekable stream for an index footer. Leaves the
+// read position unspecified; returns false (with `index` empty) for
+// files written before the footer existed.
+inline bool read_block_index(std::istream& in, std::vector<BlockIndexEntry>& index) {
+    index.clear();
+    in.clear();
+    in.seekg(0, std::ios::end);
+    std::streamoff fileSize = in.tellg();
+    if (fileSize < 8) {
+        return false;
+    }
+    in.seekg(fileSize - 8);
+    uint32_t count = 0;
+    char magic[4] = {};
+    if (!read_u32(in, count)) {
+        return false;
+    }
+    in.read(magic, 4);
+    if (in.gcount() != 4 || std::memcmp(magic, "BKIX", 4) != 0) {
+        return false;
+    }
+    std::streamoff indexStart =
+        fileSize - 8 - static_cast<std::streamoff>(count) * 16;
+    if (count == 0 || indexStart < 0) {
+        return false;
+    }
+    in.clear();
+    in.seekg(indexStart);
+    index.assign(count, BlockIndexEntry{0, 0});
+    for (uint32_t i = 0; i < count; i++) {
+        if (!read_u64(in, index[i].compOffset) || !read_u64(in, index[i].rawOffset)) {
+            index.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+// LEB128 varints (7 value bits per byte, high bit is the continuation
+// flag), stream and in-memory flavours like the u32 helpers above.
+inline void write_varint(std::ostream& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.put(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.put(static_cast<char>(v));
+}
+
+inline bool read_varint(std::istream& in, uint64_t& v) {
+    uint64_t value = 0;
+    int shift = 0;
+    for (int i = 0; i < 10; i++) {
+        int c = in.get();
+        if (c == EOF) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            v = value;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+inline void write_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline bool read_varint(const std::vector<uint8_t>& in, size_t& pos, uint64_t& v) {
+    uint64_t value = 0;
+    int shift = 0;
+    for (int i = 0; i < 10 && pos < in.size(); i++) {
+        uint8_t c = in[pos++];
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            v = value;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+// Compact frequency-table serialization: varint tokens instead of raw
+// 32-bit counts. A token t with its low bit set stands for a run of
+// (t >> 1) zero entries; otherwise it carries one nonzero count of
+// (t >> 1). Sparse tables — the common case for small inputs — shrink
+// from 4 bytes per symbol to a couple of bytes per distinct symbol.
+inline void write_frequencies_compact(std::ostream& out, const std::vector<uint32_t>& freq) {
+    write_varint(out, freq.size());
+    size_t i = 0;
+    while (i < freq.size()) {
+        if (freq[i] == 0) {
+            size_t run = 1;
+            while (i + run < freq.size() && freq[i + run] == 0) {
+                run++;
+            }
+            write_varint(out, (static_cast<uint64_t>(run) << 1) | 1);
+            i += run;
+        } else {
+            write_varint(out, static_cast<uint64_t>(freq[i]) << 1);
+            i++;
+        }
+    }
+}
+
+inline bool read_frequencies_compact(std::istream& in, std::vector<uint32_t>& freq,
+                                     uint32_t expectedCount) {
+    uint64_t count = 0;
+    if (!read_varint(in, count) || count != expectedCount) {
+        std::cerr << "Bad frequency table size\n";
+        return false;
+    }
+    freq.assign(static_cast<size_t>(count), 0);
+    size_t i = 0;
+    while (i < freq.size()) {
+        uint64_t token = 0;
+        if (!read_varint(in, token)) {
+            std::cerr << "Failed to read frequency table\n";
+            return false;
+        }
+        if (token & 1) {
+            uint64_t run = token >> 1;
+            if (run == 0 || run > freq.size() - i) {
+                std::cerr << "Bad zero run in frequency table\n";
+                return false;
+            }
+            i += static_cast<size_t>(run);
+        } else {
+            uint64_t value = token >> 1;
+            if (value == 0 || value > 0xFFFFFFFFu) {
+                std::cerr << "Bad count in frequency table\n";
+                return false;
+            }
+            freq[i++] = static_cast<uint32_t>(value);
+        }
+    }
+    return true;
+}
+
+inline void write_frequencies_compact(std::vector<uint8_t>& out, const std::vector<uint32_t>& freq) {
+    write_varint(out, freq.size());
+    size_t i = 0;
+    while (i < freq.size()) {
+        if (freq[i] == 0) {
+            size_t run = 1;
+            while (i + run < freq.size() && freq[i + run] == 0) {
+                run++;
+            }
+            write_varint(out, (static_cast<uint64_t>(run) << 1) | 1);
+            i += run;
+        } else {
+            write_varint(out, static_cast<uint64_t>(freq[i]) << 1);
+            i++;
+        }
+    }
+}
+
+inline bool read_frequencies_compact(const std::vector<uint8_t>& in, size_t& pos,
+                                     std::vector<uint32_t>& freq, uint32_t expectedCount) {
+    uint64_t count = 0;
+    if (!read_varint(in, pos, count) || count != expectedCount) {
+        return false;
+    }
+    freq.assign(static_cast<size_t>(count), 0);
+    size_t i = 0;
+    while (i < freq.size()) {
+        uint64_t token = 0;
+        if (!read_varint(in, pos, token)) {
+            return false;
+        }
+        if (token & 1) {
+            uint64_t run = token >> 1;
+            if (run == 0 || run > freq.size() - i) {
+                return false;
+            }
+            i += static_cast<size_t>(run);
+        } else {
+            uint64_t value = token >> 1;
+            if (value == 0 || value > 0xFFFFFFFFu) {
+                return false;
+            }
+            freq[i++] = static_cast<uint32_t>(value);
+        }
+    }
+    return true;
+}
+
+// Sidecar frequency dictionary: "FDIC" magic followed by one compact
+// frequency table. Trained once from a representative corpus and shared
+// across many encodes, it lets a tool skip both the histogram pass and
+// the embedded per-file header. The format carries only the table, so a
+// dictionary trained by one tool is usable by any other with the same
+// symbol limit.
+inline bool write_dictionary(const std::string& path, const std::vector<uint32_t>& freq) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+    const char magic[4] = {'F', 'D', 'I', 'C'};
+    out.write(magic, sizeof(magic));
+    write_frequencies_compact(out, freq);
+    return static_cast<bool>(out);
+}
+
+inline bool read_dictionary(const std::string& path, std::vector<uint32_t>& freq,
+                            uint32_t expectedCount) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || magic[0] != 'F' || magic[1] != 'D' || magic[2] != 'I' || magic[3] != 'C') {
+        return false;
+    }
+    return read_frequencies_compact(in, freq, expectedCount);
+}
+
+} // namespace codec_core
+
+#endif // CODEC_CORE_HPP
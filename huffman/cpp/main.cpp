@@ -2,65 +2,46 @@
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <queue>
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <iterator>
 
-class BitWriter {
-public:
-    explicit BitWriter(std::ostream& s) : stream(s), buffer(0), bitsInBuffer(0) {}
-
-    void write_bit(int bit) {
-        buffer = static_cast<uint8_t>((buffer << 1) | (bit & 1));
-        bitsInBuffer++;
-        if (bitsInBuffer == 8) {
-            stream.put(static_cast<char>(buffer));
-            bitsInBuffer = 0;
-            buffer = 0;
-        }
-    }
+#include "../../common/codec_core.hpp"
 
-    void flush() {
-        if (bitsInBuffer > 0) {
-            buffer <<= (8 - bitsInBuffer);
-            stream.put(static_cast<char>(buffer));
-            bitsInBuffer = 0;
-            buffer = 0;
-        }
-    }
+namespace huffman {
 
-private:
-    std::ostream& stream;
-    uint8_t buffer;
-    int bitsInBuffer;
-};
+using codec_core::MappedFile;
+using codec_core::ThreadPool;
+using codec_core::BitWriter;
+using codec_core::BitReader;
+using codec_core::histogram_add;
+using codec_core::histogram_reduce;
+using codec_core::write_u32;
+using codec_core::read_u32;
 
-class BitReader {
-public:
-    explicit BitReader(std::istream& s) : stream(s), currentByte(0), bitsRemaining(0), reachedEof(false) {}
-
-    int read_bit() {
-        if (bitsRemaining == 0) {
-            int c = stream.get();
-            if (c == EOF) {
-                reachedEof = true;
-                return 0;
-            }
-            currentByte = static_cast<uint8_t>(c);
-            bitsRemaining = 8;
-        }
-        bitsRemaining--;
-        return (currentByte >> bitsRemaining) & 1;
-    }
+// Opt-in --stats instrumentation: when enabled, the phases below record
+// wall time and derived metrics here and main() emits them as one
+// machine-parsable key=value line on stderr.
+static bool g_stats_enabled = false;
+static std::ostringstream g_stats;
 
-    bool eof() const {
-        return reachedEof;
+static void stats_add(const char* key, double value) {
+    if (g_stats_enabled) {
+        g_stats << ' ' << key << '=' << value;
     }
+}
 
-private:
-    std::istream& stream;
-    uint8_t currentByte;
-    int bitsRemaining;
-    bool reachedEof;
+// Per-phase fields come from the single-stream paths; blocked mode would
+// interleave per-block values from worker threads, so it suspends them and
+// reports only the totals line.
+struct StatsSuspend {
+    bool saved;
+    StatsSuspend() : saved(g_stats_enabled) { g_stats_enabled = false; }
+    ~StatsSuspend() { g_stats_enabled = saved; }
 };
 
 static const uint32_t SYMBOL_LIMIT = 257;
@@ -86,79 +67,190 @@ struct NodeCmp {
     }
 };
 
-static Node* build_tree(const std::vector<uint32_t>& freq) {
+// Flat node arena: every node of one tree lives in a single preallocated
+// vector (at most 2 * SYMBOL_LIMIT nodes), so building costs no per-node
+// heap allocation and teardown is one vector release instead of a
+// recursive delete. The reserve up front keeps Node* stable.
+class HuffTree {
+public:
+    HuffTree() : root_(nullptr) {
+        nodes_.reserve(2 * SYMBOL_LIMIT);
+    }
+
+    Node* make_node(uint32_t symbol, uint64_t freq, Node* left, Node* right) {
+        nodes_.push_back(Node{symbol, freq, left, right});
+        return &nodes_.back();
+    }
+
+    void set_root(Node* root) { root_ = root; }
+    Node* root() const { return root_; }
+
+private:
+    std::vector<Node> nodes_;
+    Node* root_;
+};
+
+static void build_tree(const std::vector<uint32_t>& freq, HuffTree& tree) {
     std::priority_queue<Node*, std::vector<Node*>, NodeCmp> pq;
     for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
         if (freq[s] == 0) {
             continue;
         }
-        Node* n = new Node;
-        n->symbol = s;
-        n->freq = freq[s];
-        n->left = nullptr;
-        n->right = nullptr;
-        pq.push(n);
+        pq.push(tree.make_node(s, freq[s], nullptr, nullptr));
     }
     if (pq.empty()) {
-        Node* n = new Node;
-        n->symbol = EOF_SYMBOL;
-        n->freq = 1;
-        n->left = nullptr;
-        n->right = nullptr;
-        return n;
+        tree.set_root(tree.make_node(EOF_SYMBOL, 1, nullptr, nullptr));
+        return;
     }
     if (pq.size() == 1) {
         Node* only = pq.top();
         pq.pop();
-        Node* parent = new Node;
-        parent->symbol = 0;
-        parent->freq = only->freq;
-        parent->left = only;
-        parent->right = nullptr;
-        pq.push(parent);
+        pq.push(tree.make_node(0, only->freq, only, nullptr));
     }
     while (pq.size() > 1) {
         Node* a = pq.top();
         pq.pop();
         Node* b = pq.top();
         pq.pop();
-        Node* parent = new Node;
-        parent->symbol = 0;
-        parent->freq = a->freq + b->freq;
-        parent->left = a;
-        parent->right = b;
-        pq.push(parent);
+        pq.push(tree.make_node(0, a->freq + b->freq, a, b));
     }
-    return pq.top();
+    tree.set_root(pq.top());
 }
 
-static void destroy_tree(Node* node) {
+// Packed code table entry: the code bits right-aligned in a uint64_t plus
+// the code length, so the encode loop emits a whole symbol with one
+// write_bits call instead of one write_bit per '0'/'1' character.
+struct CodeEntry {
+    uint64_t bits;
+    uint8_t length;
+};
+
+static void build_codes(const Node* node, std::vector<CodeEntry>& codes, uint64_t bits, int length) {
     if (!node) {
         return;
     }
-    destroy_tree(node->left);
-    destroy_tree(node->right);
-    delete node;
+    if (is_leaf(node)) {
+        if (length == 0) {
+            codes[node->symbol] = CodeEntry{0, 1};
+        } else {
+            codes[node->symbol] = CodeEntry{bits, static_cast<uint8_t>(length)};
+        }
+        return;
+    }
+    build_codes(node->left, codes, bits << 1, length + 1);
+    build_codes(node->right, codes, (bits << 1) | 1, length + 1);
 }
 
-static void build_codes(Node* node, std::vector<std::string>& codes, std::string& prefix) {
+// Flat decode table indexed by the next DECODE_TABLE_BITS bits of the stream.
+// Codes no longer than DECODE_TABLE_BITS resolve with one lookup; longer codes
+// leave length == 0 in their prefix slots and fall back to walking the tree.
+static const int DECODE_TABLE_BITS = 12;
+
+struct DecodeEntry {
+    uint16_t symbol;
+    uint8_t length;
+};
+
+static void fill_decode_table(const Node* node, uint32_t bits, int length, std::vector<DecodeEntry>& table) {
     if (!node) {
         return;
     }
     if (is_leaf(node)) {
-        if (prefix.empty()) {
-            codes[node->symbol] = "0";
-        } else {
-            codes[node->symbol] = prefix;
+        if (length == 0 || length > DECODE_TABLE_BITS) {
+            return;
+        }
+        uint32_t start = bits << (DECODE_TABLE_BITS - length);
+        uint32_t span = 1u << (DECODE_TABLE_BITS - length);
+        for (uint32_t i = 0; i < span; i++) {
+            table[start + i].symbol = static_cast<uint16_t>(node->symbol);
+            table[start + i].length = static_cast<uint8_t>(length);
         }
         return;
     }
-    prefix.push_back('0');
-    build_codes(node->left, codes, prefix);
-    prefix.pop_back();
-    prefix.push_back('1');
-    build_codes(node->right, codes, prefix);
-    prefix.pop_back();
+    fill_decode_table(node->left, bits << 1, length + 1, table);
+    fill_decode_table(node->right, (bits << 1) | 1, length + 1, table);
+}
+
+static std::vector<DecodeEntry> build_decode_table(const Node* root) {
+    std::vector<DecodeEntry> table(1u << DECODE_TABLE_BITS);
+    fill_decode_table(root, 0, 0, table);
+    return table;
+}
+
+// Canonical code assignment: symbols sorted by (length, symbol index)
+// receive consecutive code values, so a table of code lengths alone
+// reproduces the exact codes on both sides. Rejects length sets that
+// oversubscribe the code space (corrupt headers).
+static bool build_canonical_codes(const std::vector<uint8_t>& lengths, std::vector<CodeEntry>& codes) {
+    int maxLen = 0;
+    std::vector<uint32_t> countPerLen(65, 0);
+    for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+        if (lengths[s] == 0) {
+            continue;
+        }
+        if (lengths[s] > 64) {
+            return false;
+        }
+        countPerLen[lengths[s]]++;
+        maxLen = std::max<int>(maxLen, lengths[s]);
+    }
+    if (maxLen == 0) {
+        return false;
+    }
+    std::vector<uint64_t> nextCode(maxLen + 1, 0);
+    uint64_t code = 0;
+    for (int len = 1; len <= maxLen; len++) {
+        code = (code + countPerLen[len - 1]) << 1;
+        nextCode[len] = code;
+    }
+    if (maxLen < 64 &&
+        nextCode[maxLen] + countPerLen[maxLen] > (static_cast<uint64_t>(1) << maxLen)) {
+        return false;
+    }
+    for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+        if (lengths[s] != 0) {
+            codes[s] = CodeEntry{nextCode[lengths[s]]++, lengths[s]};
+        }
+    }
+    return true;
+}
+
+// Rebuilds a decode tree from explicit codes, so the compact-header path
+// can reuse the table-with-tree-fallback decode loop unchanged. Leaves
+// carry freq == 1 so a code that routes through an existing leaf (a
+// prefix conflict, impossible in a valid header) is caught.
+static bool build_tree_from_codes(const std::vector<CodeEntry>& codes, HuffTree& tree) {
+    Node* root = tree.make_node(0, 0, nullptr, nullptr);
+    tree.set_root(root);
+    for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+        if (codes[s].length == 0) {
+            continue;
+        }
+        Node* node = root;
+        for (int bit = codes[s].length - 1; bit >= 0; bit--) {
+            if (node->freq != 0) {
+                return false;
+            }
+            Node*& child = (codes[s].bits >> bit) & 1 ? node->right : node->left;
+            if (!child) {
+                child = bit == 0 ? tree.make_node(s, 1, nullptr, nullptr)
+                                 : tree.make_node(0, 0, nullptr, nullptr);
+            } else if (bit == 0) {
+                return false;
+            }
+            node = child;
+        }
+    }
+    return true;
+}
+
+static std::vector<uint32_t> build_frequencies_from_data(const uint8_t* data, size_t size) {
+    std::vector<uint32_t> freq(SYMBOL_LIMIT, 0);
+    std::vector<uint32_t> counts(4 * 256, 0);
+    histogram_add(data, size, counts.data());
+    histogram_reduce(counts.data(), freq);
+    freq[EOF_SYMBOL] = 1;
+    return freq;
 }
 
 static std::vector<uint32_t> build_frequencies_from_file(const std::string& inputPath) {
@@ -167,98 +259,398 @@ static std::vector<uint32_t> build_frequencies_from_file(const std::string& inpu
     if (!in) {
         return freq;
     }
-    char c;
-    while (in.get(c)) {
-        unsigned char uc = static_cast<unsigned char>(c);
-        freq[static_cast<uint32_t>(uc)]++;
+    std::vector<uint32_t> counts(4 * 256, 0);
+    std::vector<uint8_t> buffer(1u << 16);
+    for (;;) {
+        in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        size_t got = static_cast<size_t>(in.gcount());
+        if (got == 0) {
+            break;
+        }
+        histogram_add(buffer.data(), got, counts.data());
     }
+    histogram_reduce(counts.data(), freq);
     freq[EOF_SYMBOL] = 1;
     return freq;
 }
 
 static void write_frequencies(std::ostream& out, const std::vector<uint32_t>& freq) {
-    uint32_t count = static_cast<uint32_t>(freq.size());
-    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    codec_core::write_frequencies(out, freq);
+}
+
+static bool read_frequencies(std::istream& in, std::vector<uint32_t>& freq) {
+    return codec_core::read_frequencies(in, freq, SYMBOL_LIMIT);
+}
+
+// Compresses one byte span into `out` as a self-contained payload: code
+// table header followed by the EOF-terminated bitstream. The classic
+// header is the raw frequency table; the compact flavour stores only the
+// canonical code lengths (one byte per symbol instead of four), which is
+// all the decoder needs to rebuild the exact codes.
+static bool compress_payload_from_data(const uint8_t* data, size_t size, std::ostream& out,
+                                       bool compactHeader = false) {
+    double t0 = codec_core::now_ms();
+    std::vector<uint32_t> freq = build_frequencies_from_data(data, size);
+    double t1 = codec_core::now_ms();
+    HuffTree tree;
+    build_tree(freq, tree);
+    std::vector<CodeEntry> codes(SYMBOL_LIMIT);
+    build_codes(tree.root(), codes, 0, 0);
+    double t2 = codec_core::now_ms();
+
+    if (compactHeader) {
+        std::vector<uint8_t> lengths(SYMBOL_LIMIT, 0);
+        for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+            lengths[s] = codes[s].length;
+        }
+        std::fill(codes.begin(), codes.end(), CodeEntry{0, 0});
+        if (!build_canonical_codes(lengths, codes)) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(lengths.data()),
+                  static_cast<std::streamsize>(lengths.size()));
+    } else {
+        write_frequencies(out, freq);
+    }
+    BitWriter bitWriter(out);
+    for (size_t i = 0; i < size; i++) {
+        const CodeEntry& code = codes[data[i]];
+        bitWriter.write_bits(code.bits, code.length);
+    }
+    const CodeEntry& eofCode = codes[EOF_SYMBOL];
+    bitWriter.write_bits(eofCode.bits, eofCode.length);
+    bitWriter.flush();
+    if (g_stats_enabled) {
+        stats_add("histogram_ms", t1 - t0);
+        stats_add("tree_ms", t2 - t1);
+        stats_add("encode_ms", codec_core::now_ms() - t2);
+        uint64_t weightedBits = 0;
+        uint64_t symbols = 0;
+        for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+            weightedBits += static_cast<uint64_t>(freq[s]) * codes[s].length;
+            symbols += freq[s];
+        }
+        stats_add("avg_code_len", symbols > 0 ? static_cast<double>(weightedBits) / symbols : 0.0);
+    }
+    return static_cast<bool>(out);
+}
+
+// Decodes one EOF-terminated bitstream given prebuilt decode structures;
+// shared by the per-file header path above and the preset-dictionary path.
+static bool decode_bitstream(Node* root, const std::vector<DecodeEntry>& table,
+                             std::istream& in, std::ostream& out) {
+    BitReader bitReader(in);
+    bool sawEOF = false;
+    bool ok = true;
+    while (true) {
+        if (bitReader.eof()) {
+            break;
+        }
+        uint32_t window = bitReader.peek_bits(DECODE_TABLE_BITS);
+        const DecodeEntry& entry = table[window];
+        uint32_t symbol;
+        if (entry.length != 0) {
+            bitReader.consume_bits(entry.length);
+            symbol = entry.symbol;
+        } else {
+            Node* node = root;
+            do {
+                int bit = bitReader.read_bit();
+                if (bit == 0) {
+                    node = node->left;
+                } else {
+                    node = node->right;
+                }
+                if (!node) {
+                    break;
+                }
+            } while (!is_leaf(node));
+            if (!node) {
+                std::cerr << "Input data corrupted or truncated\n";
+                ok = false;
+                break;
+            }
+            symbol = node->symbol;
+        }
+        if (symbol == EOF_SYMBOL) {
+            sawEOF = true;
+            break;
+        }
+        unsigned char b = static_cast<unsigned char>(symbol);
+        out.put(static_cast<char>(b));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            ok = false;
+            break;
+        }
+    }
+
+    if (!sawEOF) {
+        std::cerr << "Input data corrupted or truncated\n";
+        ok = false;
+    }
+    return ok;
+}
+
+// Decodes one payload (code table header + EOF-terminated bitstream)
+// from `in`; `compactHeader` selects between the raw frequency table and
+// the canonical code-length header.
+static bool decompress_payload(std::istream& in, std::ostream& out, bool compactHeader = false) {
+    double t0 = codec_core::now_ms();
+    HuffTree tree;
+    if (compactHeader) {
+        std::vector<uint8_t> lengths(SYMBOL_LIMIT, 0);
+        in.read(reinterpret_cast<char*>(lengths.data()),
+                static_cast<std::streamsize>(lengths.size()));
+        if (in.gcount() != static_cast<std::streamsize>(lengths.size())) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        std::vector<CodeEntry> codes(SYMBOL_LIMIT);
+        if (!build_canonical_codes(lengths, codes) || !build_tree_from_codes(codes, tree)) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+    } else {
+        std::vector<uint32_t> freq;
+        if (!read_frequencies(in, freq)) {
+            return false;
+        }
+        build_tree(freq, tree);
+    }
+    Node* root = tree.root();
+    if (!root) {
+        return false;
+    }
+
+    std::vector<DecodeEntry> table = build_decode_table(root);
+    double t1 = codec_core::now_ms();
+    stats_add("setup_ms", t1 - t0);
+
+    bool ok = decode_bitstream(root, table, in, out);
+    stats_add("decode_ms", codec_core::now_ms() - t1);
+    return ok;
+}
+
+// In-memory entry points: same "HFMN" container as compress_file, but the
+// whole payload stays in caller-owned buffers with no iostreams on the
+// path, for embedders that already hold the message in memory. The file
+// mmap path below is a thin wrapper over compress_buffer.
+static bool compress_buffer(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    double t0 = codec_core::now_ms();
+    std::vector<uint32_t> freq = build_frequencies_from_data(data, size);
+    double t1 = codec_core::now_ms();
+    HuffTree tree;
+    build_tree(freq, tree);
+    std::vector<CodeEntry> codes(SYMBOL_LIMIT);
+    build_codes(tree.root(), codes, 0, 0);
+    double t2 = codec_core::now_ms();
+
+    const char magic[4] = {'H', 'F', 'M', 'N'};
+    out.insert(out.end(), magic, magic + 4);
+    codec_core::write_u32_le(out, static_cast<uint32_t>(freq.size()));
     for (uint32_t v : freq) {
-        out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        codec_core::write_u32_le(out, v);
+    }
+
+    codec_core::BufferBitWriter bitWriter(out);
+    for (size_t i = 0; i < size; i++) {
+        const CodeEntry& code = codes[data[i]];
+        bitWriter.write_bits(code.bits, code.length);
+    }
+    const CodeEntry& eofCode = codes[EOF_SYMBOL];
+    bitWriter.write_bits(eofCode.bits, eofCode.length);
+    bitWriter.flush();
+    if (g_stats_enabled) {
+        stats_add("histogram_ms", t1 - t0);
+        stats_add("tree_ms", t2 - t1);
+        stats_add("encode_ms", codec_core::now_ms() - t2);
     }
+    return true;
 }
 
-static bool read_frequencies(std::istream& in, std::vector<uint32_t>& freq) {
-    uint32_t count = 0;
-    in.read(reinterpret_cast<char*>(&count), sizeof(count));
-    if (!in) {
-        std::cerr << "Failed to read frequency table\n";
+static bool decompress_buffer(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    if (size < 4 || data[0] != 'H' || data[1] != 'F' || data[2] != 'M' || data[3] != 'N') {
+        std::cerr << "Invalid input buffer format\n";
         return false;
     }
-    if (count != SYMBOL_LIMIT) {
-        std::cerr << "Bad frequency table size: " << count << "\n";
+    size_t pos = 4;
+    if (pos + 4 > size) {
+        std::cerr << "Input data corrupted or truncated\n";
         return false;
     }
-    freq.assign(count, 0);
-    in.read(reinterpret_cast<char*>(freq.data()), freq.size() * sizeof(uint32_t));
-    if (!in) {
-        std::cerr << "Failed to read frequency table\n";
+    uint32_t count = static_cast<uint32_t>(data[pos]) |
+                     (static_cast<uint32_t>(data[pos + 1]) << 8) |
+                     (static_cast<uint32_t>(data[pos + 2]) << 16) |
+                     (static_cast<uint32_t>(data[pos + 3]) << 24);
+    pos += 4;
+    if (count != SYMBOL_LIMIT || pos + 4 * static_cast<size_t>(count) > size) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+    std::vector<uint32_t> freq(count, 0);
+    for (uint32_t s = 0; s < count; s++) {
+        freq[s] = static_cast<uint32_t>(data[pos]) |
+                  (static_cast<uint32_t>(data[pos + 1]) << 8) |
+                  (static_cast<uint32_t>(data[pos + 2]) << 16) |
+                  (static_cast<uint32_t>(data[pos + 3]) << 24);
+        pos += 4;
+    }
+
+    HuffTree tree;
+    build_tree(freq, tree);
+    Node* root = tree.root();
+    if (!root) {
+        return false;
+    }
+    std::vector<DecodeEntry> table = build_decode_table(root);
+
+    // Same table-with-tree-fallback loop as decode_bitstream, reading from
+    // the span and appending to the output vector.
+    codec_core::BufferBitReader bitReader(data + pos, size - pos);
+    bool sawEOF = false;
+    while (true) {
+        if (bitReader.eof()) {
+            break;
+        }
+        uint32_t window = bitReader.peek_bits(DECODE_TABLE_BITS);
+        const DecodeEntry& entry = table[window];
+        uint32_t symbol;
+        if (entry.length != 0) {
+            bitReader.consume_bits(entry.length);
+            symbol = entry.symbol;
+        } else {
+            Node* node = root;
+            do {
+                int bit = bitReader.read_bit();
+                if (bit == 0) {
+                    node = node->left;
+                } else {
+                    node = node->right;
+                }
+                if (!node) {
+                    break;
+                }
+            } while (!is_leaf(node));
+            if (!node) {
+                std::cerr << "Input data corrupted or truncated\n";
+                return false;
+            }
+            symbol = node->symbol;
+        }
+        if (symbol == EOF_SYMBOL) {
+            sawEOF = true;
+            break;
+        }
+        out.push_back(static_cast<uint8_t>(symbol));
+    }
+    if (!sawEOF) {
+        std::cerr << "Input data corrupted or truncated\n";
         return false;
     }
     return true;
 }
 
-static bool compress_file(const std::string& inputPath, const std::string& outputPath) {
-    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
-    Node* root = build_tree(freq);
-    std::vector<std::string> codes(SYMBOL_LIMIT);
-    std::string prefix;
-    build_codes(root, codes, prefix);
-
+// Preset-dictionary mode: the frequency table is trained once from a
+// representative file and stored in a sidecar (codec_core "FDIC" format),
+// so encoding skips the histogram pass entirely and the output carries no
+// embedded table — just the "HFPD" magic and the bitstream. Every symbol
+// is clamped to at least one count during training so inputs containing
+// bytes the training corpus lacked still encode.
+static bool train_dictionary(const std::string& inputPath, const std::string& dictPath) {
     std::ifstream in(inputPath, std::ios::binary);
     if (!in) {
         std::cerr << "Cannot open input file for reading\n";
-        destroy_tree(root);
         return false;
     }
+    in.close();
+    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
+    for (uint32_t s = 0; s < SYMBOL_LIMIT; s++) {
+        if (freq[s] == 0) {
+            freq[s] = 1;
+        }
+    }
+    if (!codec_core::write_dictionary(dictPath, freq)) {
+        std::cerr << "Cannot write dictionary file\n";
+        return false;
+    }
+    return true;
+}
+
+// Tables derived from one dictionary, built once per process and reused
+// across every file encoded or decoded with it.
+struct PresetCodec {
+    HuffTree tree;
+    std::vector<CodeEntry> codes;
+    std::vector<DecodeEntry> table;
+};
+
+static bool load_preset(const std::string& dictPath, PresetCodec& preset) {
+    std::vector<uint32_t> freq;
+    if (!codec_core::read_dictionary(dictPath, freq, SYMBOL_LIMIT)) {
+        std::cerr << "Cannot read dictionary file\n";
+        return false;
+    }
+    build_tree(freq, preset.tree);
+    preset.codes.assign(SYMBOL_LIMIT, CodeEntry{0, 0});
+    build_codes(preset.tree.root(), preset.codes, 0, 0);
+    preset.table = build_decode_table(preset.tree.root());
+    return true;
+}
+
+static bool compress_file_preset(const PresetCodec& preset, const std::string& inputPath,
+                                 const std::string& outputPath) {
+    MappedFile mapped(inputPath);
+
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
     std::ofstream out(outputPath, std::ios::binary);
     if (!out) {
         std::cerr << "Cannot open output file for writing\n";
-        destroy_tree(root);
         return false;
     }
 
-    const char magic[4] = {'H', 'F', 'M', 'N'};
+    const char magic[4] = {'H', 'F', 'P', 'D'};
     out.write(magic, sizeof(magic));
-    write_frequencies(out, freq);
 
     BitWriter bitWriter(out);
-    char c;
-    while (in.get(c)) {
-        uint32_t sym = static_cast<uint8_t>(c);
-        const std::string& code = codes[sym];
-        for (char b : code) {
-            bitWriter.write_bit(b == '1' ? 1 : 0);
+    if (mapped.mapped()) {
+        const uint8_t* data = mapped.data();
+        size_t size = mapped.size();
+        for (size_t i = 0; i < size; i++) {
+            const CodeEntry& code = preset.codes[data[i]];
+            bitWriter.write_bits(code.bits, code.length);
+        }
+    } else {
+        char c;
+        while (in.get(c)) {
+            const CodeEntry& code = preset.codes[static_cast<uint8_t>(c)];
+            bitWriter.write_bits(code.bits, code.length);
+        }
+        if (in.bad()) {
+            std::cerr << "Failed to read input file\n";
+            return false;
         }
     }
-    const std::string& eofCode = codes[EOF_SYMBOL];
-    for (char b : eofCode) {
-        bitWriter.write_bit(b == '1' ? 1 : 0);
-    }
+    const CodeEntry& eofCode = preset.codes[EOF_SYMBOL];
+    bitWriter.write_bits(eofCode.bits, eofCode.length);
     bitWriter.flush();
-
-    if (in.bad()) {
-        std::cerr << "Failed to read input file\n";
-        destroy_tree(root);
-        return false;
-    }
     if (!out) {
         std::cerr << "Failed to write output file\n";
-        destroy_tree(root);
         return false;
     }
-
-    destroy_tree(root);
     return true;
 }
 
-static bool decompress_file(const std::string& inputPath, const std::string& outputPath) {
+static bool decompress_file_preset(const PresetCodec& preset, const std::string& inputPath,
+                                   const std::string& outputPath) {
     std::ifstream in(inputPath, std::ios::binary);
     if (!in) {
         std::cerr << "Cannot open input file for reading\n";
@@ -266,97 +658,1013 @@ static bool decompress_file(const std::string& inputPath, const std::string& out
     }
     char magic[4] = {};
     in.read(magic, sizeof(magic));
-    if (!in || magic[0] != 'H' || magic[1] != 'F' || magic[2] != 'M' || magic[3] != 'N') {
+    if (!in || magic[0] != 'H' || magic[1] != 'F' || magic[2] != 'P' || magic[3] != 'D') {
         std::cerr << "Invalid input file format\n";
         return false;
     }
 
-    std::vector<uint32_t> freq;
-    if (!read_frequencies(in, freq)) {
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
         return false;
     }
-    Node* root = build_tree(freq);
-    if (!root) {
+    return decode_bitstream(preset.tree.root(), preset.table, in, out);
+}
+
+// Archive mode: many members share one container, one frequency table and
+// one tree, so a directory of small files pays the header and histogram
+// cost once instead of per file. Layout: "HFAR" magic, shared frequency
+// table, then each member's EOF-terminated bitstream back to back, and a
+// trailing index (per member: varint name length, name bytes, u64 offset /
+// raw size / compressed size) followed by u64 index size, u32 member
+// count and the "ARIX" tail so readers can locate it from the end.
+
+struct ArchiveEntry {
+    std::string name;
+    uint64_t offset;
+    uint64_t rawSize;
+    uint64_t compSize;
+};
+
+// Members are stored under their base name (path prefix stripped).
+static std::string archive_member_name(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool read_archive_index(std::istream& in, std::vector<ArchiveEntry>& entries) {
+    in.seekg(-16, std::ios::end);
+    uint64_t indexBytes = 0;
+    uint32_t count = 0;
+    char tail[4] = {};
+    if (!codec_core::read_u64(in, indexBytes) || !read_u32(in, count)) {
+        return false;
+    }
+    in.read(tail, sizeof(tail));
+    if (!in || tail[0] != 'A' || tail[1] != 'R' || tail[2] != 'I' || tail[3] != 'X') {
         return false;
     }
+    in.seekg(-16 - static_cast<std::streamoff>(indexBytes), std::ios::end);
+    entries.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        ArchiveEntry entry;
+        uint64_t nameLen = 0;
+        if (!codec_core::read_varint(in, nameLen) || nameLen == 0 || nameLen > 4096) {
+            return false;
+        }
+        entry.name.resize(static_cast<size_t>(nameLen));
+        in.read(&entry.name[0], static_cast<std::streamsize>(nameLen));
+        if (!in || !codec_core::read_u64(in, entry.offset) ||
+            !codec_core::read_u64(in, entry.rawSize) ||
+            !codec_core::read_u64(in, entry.compSize)) {
+            return false;
+        }
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+static bool create_archive(const std::string& archivePath,
+                           const std::vector<std::string>& members) {
+    // Pass 1: one shared histogram over every member.
+    std::vector<uint32_t> counts(4 * 256, 0);
+    std::vector<uint8_t> buffer(1u << 16);
+    for (const std::string& path : members) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading: " << path << "\n";
+            return false;
+        }
+        for (;;) {
+            in.read(reinterpret_cast<char*>(buffer.data()),
+                    static_cast<std::streamsize>(buffer.size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
+                break;
+            }
+            histogram_add(buffer.data(), got, counts.data());
+        }
+    }
+    std::vector<uint32_t> freq(SYMBOL_LIMIT, 0);
+    histogram_reduce(counts.data(), freq);
+    freq[EOF_SYMBOL] = 1;
 
-    std::ofstream out(outputPath, std::ios::binary);
+    HuffTree tree;
+    build_tree(freq, tree);
+    std::vector<CodeEntry> codes(SYMBOL_LIMIT);
+    build_codes(tree.root(), codes, 0, 0);
+
+    std::ofstream out(archivePath, std::ios::binary);
     if (!out) {
         std::cerr << "Cannot open output file for writing\n";
-        destroy_tree(root);
         return false;
     }
+    const char magic[4] = {'H', 'F', 'A', 'R'};
+    out.write(magic, sizeof(magic));
+    write_frequencies(out, freq);
 
-    BitReader bitReader(in);
-    Node* node = root;
-    bool sawEOF = false;
-    bool ok = true;
-    while (true) {
-        int bit = bitReader.read_bit();
-        if (bit == 0) {
-            node = node->left;
-        } else {
-            node = node->right;
-        }
-        if (!node) {
-            std::cerr << "Input data corrupted or truncated\n";
-            ok = false;
-            break;
+    // Pass 2: each member is its own EOF-terminated bitstream so it can be
+    // decoded without touching its neighbours.
+    std::vector<ArchiveEntry> entries;
+    for (const std::string& path : members) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading: " << path << "\n";
+            return false;
         }
-        if (is_leaf(node)) {
-            if (node->symbol == EOF_SYMBOL) {
-                sawEOF = true;
+        ArchiveEntry entry;
+        entry.name = archive_member_name(path);
+        entry.offset = static_cast<uint64_t>(out.tellp());
+        entry.rawSize = 0;
+
+        BitWriter bitWriter(out);
+        for (;;) {
+            in.read(reinterpret_cast<char*>(buffer.data()),
+                    static_cast<std::streamsize>(buffer.size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
                 break;
             }
-            unsigned char b = static_cast<unsigned char>(node->symbol);
-            out.put(static_cast<char>(b));
-            if (!out) {
-                std::cerr << "Failed to write output file\n";
-                ok = false;
-                break;
+            for (size_t i = 0; i < got; i++) {
+                const CodeEntry& code = codes[buffer[i]];
+                bitWriter.write_bits(code.bits, code.length);
             }
-            node = root;
-        }
-        if (bitReader.eof() && node == root) {
-            break;
+            entry.rawSize += got;
         }
+        const CodeEntry& eofCode = codes[EOF_SYMBOL];
+        bitWriter.write_bits(eofCode.bits, eofCode.length);
+        bitWriter.flush();
+        entry.compSize = static_cast<uint64_t>(out.tellp()) - entry.offset;
+        entries.push_back(std::move(entry));
     }
 
-    if (!sawEOF) {
-        std::cerr << "Input data corrupted or truncated\n";
-        ok = false;
+    uint64_t indexStart = static_cast<uint64_t>(out.tellp());
+    for (const ArchiveEntry& entry : entries) {
+        codec_core::write_varint(out, entry.name.size());
+        out.write(entry.name.data(), static_cast<std::streamsize>(entry.name.size()));
+        codec_core::write_u64(out, entry.offset);
+        codec_core::write_u64(out, entry.rawSize);
+        codec_core::write_u64(out, entry.compSize);
     }
-    destroy_tree(root);
-    return ok;
-}
+    codec_core::write_u64(out, static_cast<uint64_t>(out.tellp()) - indexStart);
+    write_u32(out, static_cast<uint32_t>(entries.size()));
+    const char tail[4] = {'A', 'R', 'I', 'X'};
+    out.write(tail, sizeof(tail));
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+static bool open_archive(const std::string& archivePath, std::ifstream& in,
+                         std::vector<ArchiveEntry>& entries) {
+    in.open(archivePath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || magic[0] != 'H' || magic[1] != 'F' || magic[2] != 'A' || magic[3] != 'R') {
+        std::cerr << "Invalid input file format\n";
+        return false;
+    }
+    if (!read_archive_index(in, entries)) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+    return true;
+}
+
+static bool list_archive(const std::string& archivePath) {
+    std::ifstream in;
+    std::vector<ArchiveEntry> entries;
+    if (!open_archive(archivePath, in, entries)) {
+        return false;
+    }
+    for (const ArchiveEntry& entry : entries) {
+        std::cout << entry.name << " " << entry.rawSize << " " << entry.compSize << "\n";
+    }
+    return true;
+}
+
+// Extracts one member (by name) or, with an empty name, every member into
+// `outputDir`. The shared tree and decode table are built once.
+static bool extract_archive(const std::string& archivePath, const std::string& outputDir,
+                            const std::string& memberName) {
+    std::ifstream in;
+    std::vector<ArchiveEntry> entries;
+    if (!open_archive(archivePath, in, entries)) {
+        return false;
+    }
+
+    in.clear();
+    in.seekg(4);
+    std::vector<uint32_t> freq;
+    if (!read_frequencies(in, freq)) {
+        return false;
+    }
+    HuffTree tree;
+    build_tree(freq, tree);
+    Node* root = tree.root();
+    if (!root) {
+        return false;
+    }
+    std::vector<DecodeEntry> table = build_decode_table(root);
+
+#ifdef CODEC_HAVE_MMAP
+    ::mkdir(outputDir.c_str(), 0755);
+#endif
+
+    bool found = memberName.empty();
+    for (const ArchiveEntry& entry : entries) {
+        if (!memberName.empty() && entry.name != memberName) {
+            continue;
+        }
+        found = true;
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(entry.offset));
+        std::ofstream out(outputDir + "/" + entry.name, std::ios::binary);
+        if (!out) {
+            std::cerr << "Cannot open output file for writing: "
+                      << outputDir + "/" + entry.name << "\n";
+            return false;
+        }
+        if (!decode_bitstream(root, table, in, out)) {
+            return false;
+        }
+    }
+    if (!found) {
+        std::cerr << "Member not found in archive: " << memberName << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool compress_file(const std::string& inputPath, const std::string& outputPath) {
+    // One mapping serves both the histogram pass and the encode pass; the
+    // streaming path below opens the file twice instead.
+    MappedFile mapped(inputPath);
+
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    if (mapped.mapped()) {
+        std::vector<uint8_t> encoded;
+        encoded.reserve(mapped.size() / 2 + 1024 + 4 * SYMBOL_LIMIT);
+        compress_buffer(mapped.data(), mapped.size(), encoded);
+        out.write(reinterpret_cast<const char*>(encoded.data()),
+                  static_cast<std::streamsize>(encoded.size()));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        return true;
+    }
+
+    const char magic[4] = {'H', 'F', 'M', 'N'};
+    out.write(magic, sizeof(magic));
+
+    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
+    HuffTree tree;
+    build_tree(freq, tree);
+    std::vector<CodeEntry> codes(SYMBOL_LIMIT);
+    build_codes(tree.root(), codes, 0, 0);
+
+    write_frequencies(out, freq);
+
+    BitWriter bitWriter(out);
+    char c;
+    while (in.get(c)) {
+        uint32_t sym = static_cast<uint8_t>(c);
+        const CodeEntry& code = codes[sym];
+        bitWriter.write_bits(code.bits, code.length);
+    }
+    if (in.bad()) {
+        std::cerr << "Failed to read input file\n";
+        return false;
+    }
+    const CodeEntry& eofCode = codes[EOF_SYMBOL];
+    bitWriter.write_bits(eofCode.bits, eofCode.length);
+    bitWriter.flush();
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+
+    return true;
+}
+
+// Pipelined single-stream encode, producing the same HFMN output as
+// compress_file: a reader thread fills double buffers, this thread runs
+// the codec, and a writer thread drains completed output buffers, so
+// disk reads, compression, and writes overlap instead of alternating.
+// Worth little when the input mmaps cleanly from page cache; the gain is
+// on spinning-disk and network-filesystem sources.
+static bool compress_file_pipelined(const std::string& inputPath, const std::string& outputPath) {
+    static const size_t CHUNK_SIZE = 1u << 20;
+
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    std::vector<uint32_t> freq = build_frequencies_from_file(inputPath);
+    HuffTree tree;
+    build_tree(freq, tree);
+    std::vector<CodeEntry> codes(SYMBOL_LIMIT);
+    build_codes(tree.root(), codes, 0, 0);
+
+    const char magic[4] = {'H', 'F', 'M', 'N'};
+    out.write(magic, sizeof(magic));
+    write_frequencies(out, freq);
+
+    codec_core::BufferQueue inQueue(2);
+    codec_core::BufferQueue outQueue(2);
+
+    std::thread reader([&] {
+        for (;;) {
+            std::vector<char> buf(CHUNK_SIZE);
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
+                break;
+            }
+            buf.resize(got);
+            inQueue.push(std::move(buf));
+            if (got < CHUNK_SIZE) {
+                break;
+            }
+        }
+        inQueue.close();
+    });
+
+    bool writeOk = true;
+    std::thread writer([&] {
+        std::vector<char> buf;
+        while (outQueue.pop(buf)) {
+            out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+            if (!out) {
+                writeOk = false;
+            }
+        }
+    });
+
+    {
+        codec_core::QueueStreamBuf qbuf(outQueue, 1u << 16);
+        std::ostream qout(&qbuf);
+        BitWriter bitWriter(qout);
+        std::vector<char> chunk;
+        while (inQueue.pop(chunk)) {
+            for (char c : chunk) {
+                const CodeEntry& code = codes[static_cast<uint8_t>(c)];
+                bitWriter.write_bits(code.bits, code.length);
+            }
+        }
+        const CodeEntry& eofCode = codes[EOF_SYMBOL];
+        bitWriter.write_bits(eofCode.bits, eofCode.length);
+        bitWriter.flush();
+        qout.flush();
+    }
+    outQueue.close();
+    reader.join();
+    writer.join();
+
+    if (in.bad()) {
+        std::cerr << "Failed to read input file\n";
+        return false;
+    }
+    if (!writeOk || !out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+// Compact-header single-payload container ("HFCN"): the same bitstream
+// as HFMN behind a 257-byte code-length header instead of the 1032-byte
+// frequency table. On sub-4 KiB inputs the header is the dominant cost,
+// so this roughly quarters the fixed overhead. HFMN stays the default
+// because the Go and Rust tools decode it.
+static bool compress_file_compact(const std::string& inputPath, const std::string& outputPath) {
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+    const char magic[4] = {'H', 'F', 'C', 'N'};
+    out.write(magic, sizeof(magic));
+
+    MappedFile mapped(inputPath);
+    if (mapped.mapped()) {
+        return compress_payload_from_data(mapped.data(), mapped.size(), out, true);
+    }
+
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    return compress_payload_from_data(data.data(), data.size(), out, true);
+}
+
+static const uint32_t DEFAULT_BLOCK_SIZE = 1u << 20;
+
+// Block-parallel encode: the input is split into fixed-size blocks, each
+// compressed independently (own frequency table) on the thread pool, and the
+// container records a (raw size, compressed size) pair per block. A zero/zero
+// record terminates the block list.
+static bool compress_file_blocks(const std::string& inputPath, const std::string& outputPath,
+                                 uint32_t blockSize, unsigned threadCount) {
+    StatsSuspend statsSuspend;
+    if (blockSize == 0) {
+        blockSize = DEFAULT_BLOCK_SIZE;
+    }
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+    }
+
+    MappedFile mapped(inputPath);
+    std::ifstream in;
+    if (!mapped.mapped()) {
+        in.open(inputPath, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot open input file for reading\n";
+            return false;
+        }
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    const char magic[4] = {'H', 'F', 'B', 'K'};
+    out.write(magic, sizeof(magic));
+    write_u32(out, blockSize);
+
+    ThreadPool pool(threadCount);
+    using BlockResult = std::pair<uint32_t, std::string>;
+    std::deque<std::future<BlockResult>> pending;
+    // Bound the number of in-flight blocks so memory stays O(threads * block).
+    const size_t window = static_cast<size_t>(threadCount) * 4;
+
+    // Per-block offsets for the seekable index footer; compressed offsets
+    // start past the magic and the block-size field.
+    std::vector<codec_core::BlockIndexEntry> index;
+    uint64_t compOffset = 8;
+    uint64_t rawOffset = 0;
+
+    auto submit_block = [&pool](std::function<BlockResult()> fn) {
+        auto task = std::make_shared<std::packaged_task<BlockResult()>>(std::move(fn));
+        std::future<BlockResult> fut = task->get_future();
+        pool.submit([task] { (*task)(); });
+        return fut;
+    };
+
+    auto write_front = [&]() -> bool {
+        BlockResult block = pending.front().get();
+        pending.pop_front();
+        index.push_back(codec_core::BlockIndexEntry{compOffset, rawOffset});
+        compOffset += 8 + block.second.size();
+        rawOffset += block.first;
+        write_u32(out, block.first);
+        write_u32(out, static_cast<uint32_t>(block.second.size()));
+        out.write(block.second.data(), static_cast<std::streamsize>(block.second.size()));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        return true;
+    };
+
+    if (mapped.mapped()) {
+        const uint8_t* data = mapped.data();
+        size_t size = mapped.size();
+        size_t offset = 0;
+        while (offset < size) {
+            size_t len = std::min<size_t>(blockSize, size - offset);
+            const uint8_t* p = data + offset;
+            pending.push_back(submit_block([p, len]() -> BlockResult {
+                std::ostringstream os;
+                compress_payload_from_data(p, len, os);
+                return BlockResult(static_cast<uint32_t>(len), os.str());
+            }));
+            offset += len;
+            if (pending.size() >= window && !write_front()) {
+                return false;
+            }
+        }
+    } else {
+        for (;;) {
+            auto buf = std::make_shared<std::vector<uint8_t>>(blockSize);
+            in.read(reinterpret_cast<char*>(buf->data()), static_cast<std::streamsize>(buf->size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) {
+                break;
+            }
+            buf->resize(got);
+            pending.push_back(submit_block([buf]() -> BlockResult {
+                std::ostringstream os;
+                compress_payload_from_data(buf->data(), buf->size(), os);
+                return BlockResult(static_cast<uint32_t>(buf->size()), os.str());
+            }));
+            if (pending.size() >= window && !write_front()) {
+                return false;
+            }
+        }
+        if (in.bad()) {
+            std::cerr << "Failed to read input file\n";
+            return false;
+        }
+    }
+
+    while (!pending.empty()) {
+        if (!write_front()) {
+            return false;
+        }
+    }
+
+    write_u32(out, 0);
+    write_u32(out, 0);
+    codec_core::write_block_index(out, index);
+    if (!out) {
+        std::cerr << "Failed to write output file\n";
+        return false;
+    }
+    return true;
+}
+
+// Batch mode over a manifest of independent input/output pairs, scheduled
+// on one work-stealing pool. Small files run as whole-file tasks; files of
+// at least BATCH_SPLIT_SIZE are split into DEFAULT_BLOCK_SIZE blocks
+// compressed as separate subtasks — spawned onto the splitting worker's
+// own deque and stolen by whoever runs dry — and reassembled into the same
+// "HFBK" container compress_file_blocks writes. That keeps every core busy
+// until the queue drains instead of letting one huge file pin the batch.
+
+static const uint64_t BATCH_SPLIT_SIZE = 4ull * DEFAULT_BLOCK_SIZE;
+
+// Shared state for one split file: the mapping stays alive until the last
+// block task has finished and the container has been written.
+struct BatchFileJob {
+    MappedFile mapped;
+    std::string outputPath;
+    std::vector<std::string> blocks;
+    std::atomic<size_t> remaining;
+    std::atomic<bool>* batchOk;
+
+    BatchFileJob(const std::string& input, const std::string& output, std::atomic<bool>* ok)
+        : mapped(input), outputPath(output), remaining(0), batchOk(ok) {}
+};
+
+static bool write_batch_container(const BatchFileJob& job) {
+    std::ofstream out(job.outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing: " << job.outputPath << "\n";
+        return false;
+    }
+    const char magic[4] = {'H', 'F', 'B', 'K'};
+    out.write(magic, sizeof(magic));
+    write_u32(out, DEFAULT_BLOCK_SIZE);
+
+    std::vector<codec_core::BlockIndexEntry> index;
+    uint64_t compOffset = 8;
+    uint64_t rawOffset = 0;
+    size_t size = job.mapped.size();
+    for (size_t i = 0; i < job.blocks.size(); i++) {
+        uint32_t rawSize = static_cast<uint32_t>(
+            std::min<size_t>(DEFAULT_BLOCK_SIZE, size - i * static_cast<size_t>(DEFAULT_BLOCK_SIZE)));
+        const std::string& payload = job.blocks[i];
+        index.push_back(codec_core::BlockIndexEntry{compOffset, rawOffset});
+        compOffset += 8 + payload.size();
+        rawOffset += rawSize;
+        write_u32(out, rawSize);
+        write_u32(out, static_cast<uint32_t>(payload.size()));
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    }
+    write_u32(out, 0);
+    write_u32(out, 0);
+    codec_core::write_block_index(out, index);
+    if (!out) {
+        std::cerr << "Failed to write output file: " << job.outputPath << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool compress_many(const std::string& manifestPath, unsigned threadCount) {
+    std::vector<codec_core::ManifestEntry> entries;
+    if (!codec_core::read_manifest(manifestPath, entries)) {
+        std::cerr << "Cannot read manifest file\n";
+        return false;
+    }
+
+    std::atomic<bool> ok(true);
+    size_t splitFiles = 0;
+    unsigned poolThreads = 0;
+    {
+        StatsSuspend statsSuspend;
+        codec_core::WorkStealingPool pool(threadCount);
+        poolThreads = pool.size();
+
+        for (const codec_core::ManifestEntry& entry : entries) {
+            if (codec_core::file_size(entry.input) >= BATCH_SPLIT_SIZE) {
+                auto job = std::make_shared<BatchFileJob>(entry.input, entry.output, &ok);
+                if (job->mapped.mapped()) {
+                    splitFiles++;
+                    pool.submit([&pool, job] {
+                        size_t size = job->mapped.size();
+                        size_t blockCount = (size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+                        job->blocks.resize(blockCount);
+                        job->remaining.store(blockCount);
+                        for (size_t i = 0; i < blockCount; i++) {
+                            pool.submit([job, i] {
+                                size_t offset = i * static_cast<size_t>(DEFAULT_BLOCK_SIZE);
+                                size_t len = std::min<size_t>(DEFAULT_BLOCK_SIZE,
+                                                              job->mapped.size() - offset);
+                                std::ostringstream os;
+                                compress_payload_from_data(job->mapped.data() + offset, len, os);
+                                job->blocks[i] = os.str();
+                                // The last block to finish writes the container.
+                                if (job->remaining.fetch_sub(1) == 1 &&
+                                    !write_batch_container(*job)) {
+                                    job->batchOk->store(false);
+                                }
+                            });
+                        }
+                    });
+                    continue;
+                }
+                // Mapping unavailable: fall through to the whole-file task.
+            }
+            pool.submit([entry, &ok] {
+                if (!compress_file(entry.input, entry.output)) {
+                    ok.store(false);
+                }
+            });
+        }
+
+        pool.wait_idle();
+    }
+    stats_add("files", static_cast<double>(entries.size()));
+    stats_add("split_files", static_cast<double>(splitFiles));
+    stats_add("pool_threads", static_cast<double>(poolThreads));
+    return ok.load();
+}
+
+// Blocks are self-contained, so decode parallelizes the same way encode
+// does: records are read in order, payloads decoded on the thread pool,
+// and results written back in order through a bounded window.
+static bool decompress_file_blocks(std::istream& in, std::ostream& out, unsigned threadCount) {
+    StatsSuspend statsSuspend;
+    uint32_t blockSize = 0;
+    if (!read_u32(in, blockSize)) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+    }
+
+    ThreadPool pool(threadCount);
+    using BlockResult = std::pair<bool, std::string>;
+    std::deque<std::future<BlockResult>> pending;
+    const size_t window = static_cast<size_t>(threadCount) * 4;
+
+    auto submit_block = [&pool](std::function<BlockResult()> fn) {
+        auto task = std::make_shared<std::packaged_task<BlockResult()>>(std::move(fn));
+        std::future<BlockResult> fut = task->get_future();
+        pool.submit([task] { (*task)(); });
+        return fut;
+    };
+
+    auto write_front = [&]() -> bool {
+        BlockResult block = pending.front().get();
+        pending.pop_front();
+        if (!block.first) {
+            return false;
+        }
+        out.write(block.second.data(), static_cast<std::streamsize>(block.second.size()));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        return true;
+    };
+
+    for (;;) {
+        uint32_t rawSize = 0;
+        uint32_t compSize = 0;
+        if (!read_u32(in, rawSize) || !read_u32(in, compSize)) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        if (rawSize == 0 && compSize == 0) {
+            break;
+        }
+        auto payload = std::make_shared<std::string>(compSize, '\0');
+        in.read(&(*payload)[0], static_cast<std::streamsize>(compSize));
+        if (!in) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        pending.push_back(submit_block([payload]() -> BlockResult {
+            std::istringstream ps(*payload);
+            std::ostringstream os;
+            bool ok = decompress_payload(ps, os);
+            return BlockResult(ok, os.str());
+        }));
+        if (pending.size() >= window && !write_front()) {
+            return false;
+        }
+    }
+
+    while (!pending.empty()) {
+        if (!write_front()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Serves one byte range of the uncompressed stream from a blocked
+// container. The footer index (when present) jumps straight to the block
+// covering the range start; pre-index files fall back to hopping the
+// record headers, which still skips the payload decode for every block
+// before the range.
+static bool decompress_file_range(const std::string& inputPath, const std::string& outputPath,
+                                  uint64_t offset, uint64_t length) {
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || magic[0] != 'H' || magic[1] != 'F' || magic[2] != 'B' || magic[3] != 'K') {
+        std::cerr << "Range decode requires a blocked (HFBK) file\n";
+        return false;
+    }
+    uint32_t blockSize = 0;
+    if (!read_u32(in, blockSize)) {
+        std::cerr << "Input data corrupted or truncated\n";
+        return false;
+    }
+
+    std::vector<codec_core::BlockIndexEntry> index;
+    bool haveIndex = codec_core::read_block_index(in, index);
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    uint64_t rawPos = 0;
+    std::streamoff dataStart = 8;
+    if (haveIndex) {
+        auto it = std::upper_bound(
+            index.begin(), index.end(), offset,
+            [](uint64_t v, const codec_core::BlockIndexEntry& e) { return v < e.rawOffset; });
+        if (it != index.begin()) {
+            --it;
+        }
+        dataStart = static_cast<std::streamoff>(it->compOffset);
+        rawPos = it->rawOffset;
+    }
+    in.clear();
+    in.seekg(dataStart);
+
+    uint64_t end = offset + length;
+    while (rawPos < end) {
+        uint32_t rawSize = 0;
+        uint32_t compSize = 0;
+        if (!read_u32(in, rawSize) || !read_u32(in, compSize)) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        if (rawSize == 0 && compSize == 0) {
+            break;
+        }
+        if (rawPos + rawSize <= offset) {
+            in.seekg(static_cast<std::streamoff>(compSize), std::ios::cur);
+            rawPos += rawSize;
+            continue;
+        }
+        std::string payload(compSize, '\0');
+        in.read(&payload[0], static_cast<std::streamsize>(compSize));
+        if (!in) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        std::istringstream ps(payload);
+        std::ostringstream os;
+        if (!decompress_payload(ps, os)) {
+            return false;
+        }
+        std::string blockData = os.str();
+        if (blockData.size() != rawSize) {
+            std::cerr << "Input data corrupted or truncated\n";
+            return false;
+        }
+        uint64_t from = offset > rawPos ? offset - rawPos : 0;
+        uint64_t to = std::min<uint64_t>(rawSize, end - rawPos);
+        out.write(blockData.data() + from, static_cast<std::streamsize>(to - from));
+        if (!out) {
+            std::cerr << "Failed to write output file\n";
+            return false;
+        }
+        rawPos += rawSize;
+    }
+    return static_cast<bool>(out);
+}
+
+static bool decompress_file(const std::string& inputPath, const std::string& outputPath,
+                            unsigned threadCount = 0) {
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open input file for reading\n";
+        return false;
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (!in || magic[0] != 'H' || magic[1] != 'F') {
+        std::cerr << "Invalid input file format\n";
+        return false;
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open output file for writing\n";
+        return false;
+    }
+
+    if (magic[2] == 'M' && magic[3] == 'N') {
+        return decompress_payload(in, out);
+    }
+    if (magic[2] == 'C' && magic[3] == 'N') {
+        return decompress_payload(in, out, true);
+    }
+    if (magic[2] == 'B' && magic[3] == 'K') {
+        return decompress_file_blocks(in, out, threadCount);
+    }
+    std::cerr << "Invalid input file format\n";
+    return false;
+}
+
+} // namespace huffman
 
 void huffman_encode_file(const std::string& inputPath, const std::string& outputPath) {
-    (void)compress_file(inputPath, outputPath);
+    (void)huffman::compress_file(inputPath, outputPath);
 }
 
 void huffman_decode_file(const std::string& inputPath, const std::string& outputPath) {
-    (void)decompress_file(inputPath, outputPath);
+    (void)huffman::decompress_file(inputPath, outputPath);
 }
 
+// Buffer-to-buffer entry points for embedders; see compress_buffer /
+// decompress_buffer. Output is appended to `out`.
+bool huffman_encode_buffer(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    return huffman::compress_buffer(data, size, out);
+}
+
+bool huffman_decode_buffer(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    return huffman::decompress_buffer(data, size, out);
+}
+
+#ifndef ENCODING_NO_MAIN
 int main(int argc, char** argv) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " encode|decode input output\n";
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stats") {
+            huffman::g_stats_enabled = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    bool shortMode = !args.empty() && (args[0] == "list-archive" || args[0] == "encode-many");
+    if (args.size() < 2 || (args.size() < 3 && !shortMode)) {
+        std::cerr << "Usage: " << argv[0] << " encode|encode-compact|encode-pipeline|decode input output [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-blocks input output [block_size] [threads] [--stats]\n";
+        std::cerr << "       " << argv[0] << " decode input output [threads] [--stats]\n";
+        std::cerr << "       " << argv[0] << " train input dict [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-preset|decode-preset input output dict [input output ...] [--stats]\n";
+        std::cerr << "       " << argv[0] << " decode-range input output offset length [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-archive archive member [member ...] [--stats]\n";
+        std::cerr << "       " << argv[0] << " list-archive archive [--stats]\n";
+        std::cerr << "       " << argv[0] << " decode-archive archive output_dir [member] [--stats]\n";
+        std::cerr << "       " << argv[0] << " encode-many manifest [threads] [--stats]\n";
         return 1;
     }
-    std::string mode = argv[1];
-    std::string inputPath = argv[2];
-    std::string outputPath = argv[3];
+    std::string mode = args[0];
+    std::string inputPath = args[1];
+    std::string outputPath = args.size() > 2 ? args[2] : std::string();
 
     bool ok = true;
+    double t0 = codec_core::now_ms();
 
-    if (mode == "encode") {
-        ok = compress_file(inputPath, outputPath);
-    } else if (mode == "decode") {
-        ok = decompress_file(inputPath, outputPath);
+    if (mode == "encode" && args.size() == 3) {
+        ok = huffman::compress_file(inputPath, outputPath);
+    } else if (mode == "encode-compact" && args.size() == 3) {
+        ok = huffman::compress_file_compact(inputPath, outputPath);
+    } else if (mode == "encode-pipeline" && args.size() == 3) {
+        ok = huffman::compress_file_pipelined(inputPath, outputPath);
+    } else if (mode == "train" && args.size() == 3) {
+        ok = huffman::train_dictionary(inputPath, outputPath);
+    } else if ((mode == "encode-preset" || mode == "decode-preset") &&
+               args.size() >= 4 && args.size() % 2 == 0) {
+        // The dictionary tables are built once here and reused for every
+        // input/output pair that follows.
+        bool encode = mode == "encode-preset";
+        huffman::PresetCodec preset;
+        ok = huffman::load_preset(args[3], preset);
+        if (ok) {
+            ok = encode ? huffman::compress_file_preset(preset, inputPath, outputPath)
+                        : huffman::decompress_file_preset(preset, inputPath, outputPath);
+        }
+        for (size_t i = 4; ok && i + 1 < args.size(); i += 2) {
+            ok = encode ? huffman::compress_file_preset(preset, args[i], args[i + 1])
+                        : huffman::decompress_file_preset(preset, args[i], args[i + 1]);
+        }
+    } else if (mode == "encode-blocks") {
+        uint32_t blockSize = huffman::DEFAULT_BLOCK_SIZE;
+        unsigned threads = 0;
+        if (args.size() >= 4) {
+            blockSize = static_cast<uint32_t>(std::stoul(args[3]));
+        }
+        if (args.size() >= 5) {
+            threads = static_cast<unsigned>(std::stoul(args[4]));
+        }
+        ok = huffman::compress_file_blocks(inputPath, outputPath, blockSize, threads);
+    } else if (mode == "decode" && (args.size() == 3 || args.size() == 4)) {
+        unsigned threads = 0;
+        if (args.size() == 4) {
+            threads = static_cast<unsigned>(std::stoul(args[3]));
+        }
+        ok = huffman::decompress_file(inputPath, outputPath, threads);
+    } else if (mode == "decode-range" && args.size() == 5) {
+        ok = huffman::decompress_file_range(inputPath, outputPath,
+                                            std::stoull(args[3]), std::stoull(args[4]));
+    } else if (mode == "encode-archive" && args.size() >= 3) {
+        std::vector<std::string> members(args.begin() + 2, args.end());
+        ok = huffman::create_archive(inputPath, members);
+    } else if (mode == "list-archive" && args.size() == 2) {
+        ok = huffman::list_archive(inputPath);
+    } else if (mode == "decode-archive" && (args.size() == 3 || args.size() == 4)) {
+        ok = huffman::extract_archive(inputPath, outputPath,
+                                      args.size() == 4 ? args[3] : std::string());
+    } else if (mode == "encode-many" && (args.size() == 2 || args.size() == 3)) {
+        unsigned threads = args.size() == 3 ? static_cast<unsigned>(std::stoul(args[2])) : 0;
+        ok = huffman::compress_many(inputPath, threads);
     } else {
         std::cerr << "Unknown mode\n";
         return 1;
     }
 
+    if (huffman::g_stats_enabled) {
+        double totalMs = codec_core::now_ms() - t0;
+        uint64_t bytesIn = codec_core::file_size(inputPath);
+        uint64_t bytesOut = codec_core::file_size(outputPath);
+        uint64_t symbols = mode == "decode" ? bytesOut : bytesIn;
+        std::cerr << "STATS tool=huffman mode=" << mode
+                  << " ok=" << (ok ? 1 : 0)
+                  << " bytes_in=" << bytesIn
+                  << " bytes_out=" << bytesOut
+                  << " total_ms=" << totalMs
+                  << " symbols_per_s=" << (totalMs > 0.0 ? static_cast<double>(symbols) / (totalMs / 1000.0) : 0.0)
+                  << huffman::g_stats.str() << "\n";
+    }
+
     return ok ? 0 : 1;
 }
+#endif // ENCODING_NO_MAIN
@@ -1,98 +1,78 @@
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <stdexcept>
 #include <chrono>
 
+#include "../../common/codec_core.hpp"
+
 namespace range_coder {
 
+using codec_core::SymbolLookup;
+using codec_core::build_symbol_lookup;
+using codec_core::build_cumulative;
+using codec_core::histogram_add;
+using codec_core::histogram_reduce;
+using codec_core::write_u32;
+using codec_core::read_u32;
+using codec_core::write_u32_le;
+using codec_core::read_u32_le;
+
+static bool g_stats_enabled = false;
+static std::ostringstream g_stats;
+
+static void stats_add(const char* key, double value) {
+    if (g_stats_enabled) {
+        g_stats << ' ' << key << '=' << value;
+    }
+}
+
+// The streaming container runs one whole-buffer encode()/decode() per
+// chunk; repeating the per-phase fields for every chunk would swamp the
+// stats line, so the stream paths suspend them and keep only the totals.
+struct StatsSuspend {
+    bool saved;
+    StatsSuspend() : saved(g_stats_enabled) { g_stats_enabled = false; }
+    ~StatsSuspend() { g_stats_enabled = saved; }
+};
+
 static const uint32_t SYMBOL_LIMIT = 257;
 static const uint32_t EOF_SYMBOL = SYMBOL_LIMIT - 1;
 static const uint32_t MAX_TOTAL = 1u << 24;
 static const uint32_t RENORM_THRESHOLD = 1u << 24;
 
 static void scale_frequencies(std::vector<uint32_t>& freq) {
-    uint64_t total = 0;
-    for (uint32_t f : freq) {
-        total += f;
-    }
-    if (total == 0) {
-        for (size_t i = 0; i < freq.size(); i++) {
-            freq[i] = 1;
-        }
-        return;
-    }
-    if (total <= MAX_TOTAL) {
-        return;
-    }
-    uint64_t newTotal = 0;
-    for (size_t i = 0; i < freq.size(); i++) {
-        if (freq[i] == 0) {
-            continue;
-        }
-        uint64_t scaled = static_cast<uint64_t>(freq[i]) * MAX_TOTAL / total;
-        if (scaled == 0) {
-            scaled = 1;
-        }
-        freq[i] = static_cast<uint32_t>(scaled);
-        newTotal += scaled;
-    }
-    if (newTotal == 0) {
-        uint32_t base = MAX_TOTAL / static_cast<uint32_t>(freq.size());
-        if (base == 0) {
-            base = 1;
-        }
-        for (size_t i = 0; i < freq.size(); i++) {
-            freq[i] = base;
-        }
-    }
+    codec_core::scale_frequencies(freq, MAX_TOTAL);
 }
 
 static std::vector<uint32_t> build_frequencies_from_data(const std::vector<uint8_t>& data) {
     std::vector<uint32_t> freq(SYMBOL_LIMIT, 0);
-    for (uint8_t b : data) {
-        freq[static_cast<uint32_t>(b)]++;
-    }
+    std::vector<uint32_t> counts(4 * 256, 0);
+    histogram_add(data.data(), data.size(), counts.data());
+    histogram_reduce(counts.data(), freq);
     freq[EOF_SYMBOL] = 1;
     scale_frequencies(freq);
     return freq;
 }
 
-static std::vector<uint32_t> build_cumulative(const std::vector<uint32_t>& freq) {
-    std::vector<uint32_t> cumulative(freq.size() + 1, 0);
-    for (size_t i = 0; i < freq.size(); i++) {
-        cumulative[i + 1] = cumulative[i] + freq[i];
-    }
-    if (cumulative.back() == 0) {
-        for (size_t i = 0; i < freq.size(); i++) {
-            cumulative[i + 1] = static_cast<uint32_t>(i + 1);
-        }
-    }
-    return cumulative;
-}
-
-static void write_u32_le(std::vector<uint8_t>& out, uint32_t v) {
-    out.push_back(static_cast<uint8_t>(v & 0xFF));
-    out.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
-    out.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
-}
-
-static bool read_u32_le(const std::vector<uint8_t>& in, size_t& pos, uint32_t& v) {
-    if (pos + 4 > in.size()) {
-        return false;
+// Two header layouts behind distinct magics: "RCNC" is the raw 32-bit
+// table shared with the Go and Rust coders, "RCCP" the compact varint
+// table (zero runs collapsed). The payload bitstream is identical, so
+// read_header accepts either and the decoder does not care which was
+// written.
+static void write_header(std::vector<uint8_t>& out, const std::vector<uint32_t>& freq,
+                         bool compactHeader = false) {
+    if (compactHeader) {
+        const char magic[4] = {'R', 'C', 'C', 'P'};
+        out.insert(out.end(), magic, magic + 4);
+        codec_core::write_frequencies_compact(out, freq);
+        return;
     }
-    v = static_cast<uint32_t>(in[pos]) |
-        (static_cast<uint32_t>(in[pos + 1]) << 8) |
-        (static_cast<uint32_t>(in[pos + 2]) << 16) |
-        (static_cast<uint32_t>(in[pos + 3]) << 24);
-    pos += 4;
-    return true;
-}
-
-static void write_header(std::vector<uint8_t>& out, const std::vector<uint32_t>& freq) {
     const char magic[4] = {'R', 'C', 'N', 'C'};
     out.insert(out.end(), magic, magic + 4);
     write_u32_le(out, static_cast<uint32_t>(freq.size()));
@@ -102,13 +82,16 @@ static void write_header(std::vector<uint8_t>& out, const std::vector<uint32_t>&
 }
 
 static bool read_header(const std::vector<uint8_t>& in, size_t& pos, std::vector<uint32_t>& freq) {
-    if (in.size() < 8) {
+    if (in.size() < 8 || in[0] != 'R' || in[1] != 'C') {
         return false;
     }
-    if (in[0] != 'R' || in[1] != 'C' || in[2] != 'N' || in[3] != 'C') {
+    pos = 4;
+    if (in[2] == 'C' && in[3] == 'P') {
+        return codec_core::read_frequencies_compact(in, pos, freq, SYMBOL_LIMIT);
+    }
+    if (in[2] != 'N' || in[3] != 'C') {
         return false;
     }
-    pos = 4;
     uint32_t count = 0;
     if (!read_u32_le(in, pos, count)) {
         return false;
@@ -130,7 +113,7 @@ static bool read_header(const std::vector<uint8_t>& in, size_t& pos, std::vector
 class RangeEncoder {
 public:
     explicit RangeEncoder(std::vector<uint8_t>& out)
-        : out_(out), low_(0), high_(0xFFFFFFFFu) {}
+        : out_(out), low_(0), high_(0xFFFFFFFFu), renorms_(0) {}
 
     void encode_symbol(uint32_t symbol, const std::vector<uint32_t>& cumulative) {
         uint64_t range = static_cast<uint64_t>(high_) - low_ + 1;
@@ -138,17 +121,65 @@ public:
         uint64_t symLow = cumulative[symbol];
         uint64_t symHigh = cumulative[symbol + 1];
 
-        high_ = low_ + static_cast<uint32_t>((range * symHigh) / total - 1);
-        low_ = low_ + static_cast<uint32_t>((range * symLow) / total);
+        uint64_t newHigh = (range * symHigh) / total;
+        uint64_t newLow = (range * symLow) / total;
+        // The carryless renorm below only fires when the top bytes of low
+        // and high agree, so on unlucky inputs the interval can shrink below
+        // the model total and a symbol's sub-interval can become empty. An
+        // empty interval cannot be decoded; fail loudly instead of writing
+        // a stream the decoder will spin on.
+        if (newHigh == newLow) {
+            throw std::runtime_error("Range coder interval collapsed during encode");
+        }
+        high_ = low_ + static_cast<uint32_t>(newHigh - 1);
+        low_ = low_ + static_cast<uint32_t>(newLow);
 
         while ((low_ ^ high_) < RENORM_THRESHOLD) {
             uint8_t byte = static_cast<uint8_t>(low_ >> 24);
             out_.push_back(byte);
             low_ <<= 8;
             high_ = (high_ << 8) | 0xFFu;
+            renorms_++;
         }
     }
 
+    // Batch entry point: encodes `n` literal symbols with the table pointer,
+    // total and coder state hoisted into locals, so the compiler can keep
+    // them in registers across the loop instead of reloading members on
+    // every encode_symbol call.
+    void encode_symbols(const uint8_t* src, size_t n, const std::vector<uint32_t>& cumulative) {
+        const uint32_t* cum = cumulative.data();
+        const uint64_t total = cumulative.back();
+        uint32_t low = low_;
+        uint32_t high = high_;
+        uint64_t renorms = renorms_;
+
+        for (size_t i = 0; i < n; i++) {
+            uint32_t symbol = src[i];
+            uint64_t range = static_cast<uint64_t>(high) - low + 1;
+            uint64_t newHigh = (range * cum[symbol + 1]) / total;
+            uint64_t newLow = (range * cum[symbol]) / total;
+            if (newHigh == newLow) {
+                low_ = low;
+                high_ = high;
+                renorms_ = renorms;
+                throw std::runtime_error("Range coder interval collapsed during encode");
+            }
+            high = low + static_cast<uint32_t>(newHigh - 1);
+            low = low + static_cast<uint32_t>(newLow);
+
+            while ((low ^ high) < RENORM_THRESHOLD) {
+                out_.push_back(static_cast<uint8_t>(low >> 24));
+                low <<= 8;
+                high = (high << 8) | 0xFFu;
+                renorms++;
+            }
+        }
+        low_ = low;
+        high_ = high;
+        renorms_ = renorms;
+    }
+
     void finish() {
         for (int i = 0; i < 4; ++i) {
             uint8_t byte = static_cast<uint8_t>(low_ >> 24);
@@ -157,16 +188,20 @@ public:
         }
     }
 
+    // Renormalization iterations performed so far (one per emitted byte).
+    uint64_t renorm_count() const { return renorms_; }
+
 private:
     std::vector<uint8_t>& out_;
     uint32_t low_;
     uint32_t high_;
+    uint64_t renorms_;
 };
 
 class RangeDecoder {
 public:
     RangeDecoder(const uint8_t* data, size_t size)
-        : data_(data), size_(size), pos_(0), low_(0), high_(0xFFFFFFFFu), code_(0) {
+        : data_(data), size_(size), pos_(0), low_(0), high_(0xFFFFFFFFu), code_(0), renorms_(0) {
         for (int i = 0; i < 4; ++i) {
             code_ = (code_ << 8) | read_byte();
         }
@@ -193,18 +228,120 @@ public:
         uint64_t symLow = cumulative[symbol];
         uint64_t symHigh = cumulative[symbol + 1];
 
-        high_ = low_ + static_cast<uint32_t>((range * symHigh) / total - 1);
-        low_ = low_ + static_cast<uint32_t>((range * symLow) / total);
+        uint64_t newHigh = (range * symHigh) / total;
+        uint64_t newLow = (range * symLow) / total;
+        // Mirrors the encoder's collapse check: hitting an empty interval
+        // means the stream is undecodable, and without the check the decode
+        // loop spins forever without consuming input.
+        if (newHigh == newLow) {
+            throw std::runtime_error("Range coder interval collapsed during decode");
+        }
+        high_ = low_ + static_cast<uint32_t>(newHigh - 1);
+        low_ = low_ + static_cast<uint32_t>(newLow);
 
         while ((low_ ^ high_) < RENORM_THRESHOLD) {
             low_ <<= 8;
             high_ = (high_ << 8) | 0xFFu;
             code_ = (code_ << 8) | read_byte();
+            renorms_++;
         }
 
         return symbol;
     }
 
+    uint32_t decode_symbol(const std::vector<uint32_t>& cumulative, const SymbolLookup& lut) {
+        uint64_t range = static_cast<uint64_t>(high_) - low_ + 1;
+        uint64_t total = cumulative.back();
+        uint64_t offset = code_ - low_;
+        uint32_t value = static_cast<uint32_t>(((offset + 1) * total - 1) / range);
+
+        uint32_t symbol = lut.slot[value >> lut.shift];
+        while (cumulative[symbol + 1] <= value) {
+            symbol++;
+        }
+
+        uint64_t symLow = cumulative[symbol];
+        uint64_t symHigh = cumulative[symbol + 1];
+
+        uint64_t newHigh = (range * symHigh) / total;
+        uint64_t newLow = (range * symLow) / total;
+        if (newHigh == newLow) {
+            throw std::runtime_error("Range coder interval collapsed during decode");
+        }
+        high_ = low_ + static_cast<uint32_t>(newHigh - 1);
+        low_ = low_ + static_cast<uint32_t>(newLow);
+
+        while ((low_ ^ high_) < RENORM_THRESHOLD) {
+            low_ <<= 8;
+            high_ = (high_ << 8) | 0xFFu;
+            code_ = (code_ << 8) | read_byte();
+            renorms_++;
+        }
+
+        return symbol;
+    }
+
+    // Batch entry point: decodes up to `n` literal symbols straight into
+    // `dst` through a raw pointer, with the table pointer, total and coder
+    // state held in locals across the loop. Returns the number of symbols
+    // written; a short count means EOF_SYMBOL was reached (it is consumed
+    // but not stored).
+    size_t decode_symbols(uint8_t* dst, size_t n, const std::vector<uint32_t>& cumulative,
+                          const SymbolLookup& lut) {
+        const uint32_t* cum = cumulative.data();
+        const uint16_t* slot = lut.slot.data();
+        const uint32_t shift = lut.shift;
+        const uint64_t total = cumulative.back();
+        uint32_t low = low_;
+        uint32_t high = high_;
+        uint32_t code = code_;
+        uint64_t renorms = renorms_;
+
+        size_t written = 0;
+        while (written < n) {
+            uint64_t range = static_cast<uint64_t>(high) - low + 1;
+            uint64_t offset = code - low;
+            uint32_t value = static_cast<uint32_t>(((offset + 1) * total - 1) / range);
+
+            uint32_t symbol = slot[value >> shift];
+            while (cum[symbol + 1] <= value) {
+                symbol++;
+            }
+
+            uint64_t newHigh = (range * cum[symbol + 1]) / total;
+            uint64_t newLow = (range * cum[symbol]) / total;
+            if (newHigh == newLow) {
+                low_ = low;
+                high_ = high;
+                code_ = code;
+                renorms_ = renorms;
+                throw std::runtime_error("Range coder interval collapsed during decode");
+            }
+            high = low + static_cast<uint32_t>(newHigh - 1);
+            low = low + static_cast<uint32_t>(newLow);
+
+            while ((low ^ high) < RENORM_THRESHOLD) {
+                low <<= 8;
+                high = (high << 8) | 0xFFu;
+                code = (code << 8) | read_byte();
+                renorms++;
+            }
+
+            if (symbol == EOF_SYMBOL) {
+                break;
+            }
+            dst[written++] = static_cast<uint8_t>(symbol);
+        }
+        low_ = low;
+        high_ = high;
+        code_ = code;
+        renorms_ = renorms;
+        return written;
+    }
+
+    // Renormalization iterations performed so far (one per consumed byte).
+    uint64_t renorm_count() const { return renorms_; }
+
 private:
     const uint8_t* data_;
     size_t size_;
@@ -212,6 +349,7 @@ private:
     uint32_t low_;
     uint32_t high_;
     uint32_t code_;
+    uint64_t renorms_;
 
     uint32_t read_byte() {
         if (pos_ < size_) {
@@ -221,24 +359,30 @@ private:
     }
 };
 
-std::vector<uint8_t> encode(const std::vector<uint8_t>& data) {
+std::vector<uint8_t> encode(const std::vector<uint8_t>& data, bool compactHeader = false) {
+    double t0 = codec_core::now_ms();
     std::vector<uint32_t> freq = build_frequencies_from_data(data);
     std::vector<uint32_t> cumulative = build_cumulative(freq);
+    double t1 = codec_core::now_ms();
 
     std::vector<uint8_t> out;
-    write_header(out, freq);
+    write_header(out, freq, compactHeader);
 
     RangeEncoder encoder(out);
-    for (uint8_t b : data) {
-        encoder.encode_symbol(static_cast<uint32_t>(b), cumulative);
-    }
+    encoder.encode_symbols(data.data(), data.size(), cumulative);
     encoder.encode_symbol(EOF_SYMBOL, cumulative);
     encoder.finish();
+    if (g_stats_enabled) {
+        stats_add("histogram_ms", t1 - t0);
+        stats_add("encode_ms", codec_core::now_ms() - t1);
+        stats_add("renorms", static_cast<double>(encoder.renorm_count()));
+    }
 
     return out;
 }
 
 std::vector<uint8_t> decode(const std::vector<uint8_t>& encoded) {
+    double t0 = codec_core::now_ms();
     size_t pos = 0;
     std::vector<uint32_t> freq;
     if (!read_header(encoded, pos, freq)) {
@@ -248,6 +392,9 @@ std::vector<uint8_t> decode(const std::vector<uint8_t>& encoded) {
         throw std::runtime_error("Unexpected symbol count in header");
     }
     std::vector<uint32_t> cumulative = build_cumulative(freq);
+    SymbolLookup lut = build_symbol_lookup(cumulative);
+    double t1 = codec_core::now_ms();
+    stats_add("setup_ms", t1 - t0);
 
     std::vector<uint8_t> out;
     if (pos >= encoded.size()) {
@@ -255,19 +402,882 @@ std::vector<uint8_t> decode(const std::vector<uint8_t>& encoded) {
     }
 
     RangeDecoder decoder(encoded.data() + pos, encoded.size() - pos);
+    const size_t CHUNK = 1u << 16;
     for (;;) {
-        uint32_t sym = decoder.decode_symbol(cumulative);
-        if (sym == EOF_SYMBOL) {
+        size_t base = out.size();
+        out.resize(base + CHUNK);
+        size_t got = decoder.decode_symbols(out.data() + base, CHUNK, cumulative, lut);
+        out.resize(base + got);
+        if (got < CHUNK) {
             break;
         }
-        out.push_back(static_cast<uint8_t>(sym));
+    }
+    if (g_stats_enabled) {
+        stats_add("decode_ms", codec_core::now_ms() - t1);
+        stats_add("renorms", static_cast<double>(decoder.renorm_count()));
     }
 
     return out;
 }
 
+// 64-bit-state coder: low/range carry twice the precision of the 32-bit
+// classes above, so renormalization fires once per 32 output bits instead
+// of once per byte, and each flush writes a whole 32-bit word through a
+// raw pointer into a preallocated buffer. The wider range also keeps the
+// coding interval far above the model total, so the empty-interval failure
+// mode of the carryless 32-bit coder cannot occur; carries are instead
+// propagated back through the already-written bytes.
+class Range64Encoder {
+public:
+    // `sizeHint` preallocates the output so the hot path writes through a
+    // raw pointer; finish() trims the buffer back to the bytes produced.
+    Range64Encoder(std::vector<uint8_t>& out, size_t sizeHint)
+        : out_(out), base_(out.size()), pos_(out.size()),
+          low_(0), range_(~static_cast<uint64_t>(0)), renorms_(0) {
+        out_.resize(base_ + sizeHint + 64);
+    }
+
+    void encode_symbol(uint32_t symbol, const std::vector<uint32_t>& cumulative) {
+        encode_step(cumulative[symbol], cumulative[symbol + 1], cumulative.back());
+    }
+
+    void encode_symbols(const uint8_t* src, size_t n, const std::vector<uint32_t>& cumulative) {
+        const uint32_t* cum = cumulative.data();
+        const uint32_t total = cumulative.back();
+        for (size_t i = 0; i < n; i++) {
+            uint32_t symbol = src[i];
+            encode_step(cum[symbol], cum[symbol + 1], total);
+        }
+    }
+
+    void finish() {
+        for (int i = 0; i < 2; ++i) {
+            emit32(static_cast<uint32_t>(low_ >> 32));
+            low_ <<= 32;
+        }
+        out_.resize(pos_);
+    }
+
+    // Renormalization iterations performed so far (one per emitted word).
+    uint64_t renorm_count() const { return renorms_; }
+
+private:
+    static constexpr uint64_t TOP = static_cast<uint64_t>(1) << 32;
+
+    std::vector<uint8_t>& out_;
+    size_t base_;
+    size_t pos_;
+    uint64_t low_;
+    uint64_t range_;
+    uint64_t renorms_;
+
+    void encode_step(uint32_t symLow, uint32_t symHigh, uint32_t total) {
+        uint64_t r = range_ / total;
+        uint64_t newLow = low_ + r * symLow;
+        if (newLow < low_) {
+            propagate_carry();
+        }
+        low_ = newLow;
+        range_ = r * (symHigh - symLow);
+
+        while (range_ < TOP) {
+            emit32(static_cast<uint32_t>(low_ >> 32));
+            low_ <<= 32;
+            range_ <<= 32;
+            renorms_++;
+        }
+    }
+
+    void emit32(uint32_t word) {
+        if (pos_ + 4 > out_.size()) {
+            out_.resize(out_.size() + (out_.size() >> 1) + 4096);
+        }
+        uint8_t* p = out_.data() + pos_;
+        p[0] = static_cast<uint8_t>(word >> 24);
+        p[1] = static_cast<uint8_t>(word >> 16);
+        p[2] = static_cast<uint8_t>(word >> 8);
+        p[3] = static_cast<uint8_t>(word);
+        pos_ += 4;
+    }
+
+    // The addition to `low_` overflowed 64 bits: the carry belongs to the
+    // bytes already flushed, so walk back through any 0xFF run and bump the
+    // first byte that does not wrap.
+    void propagate_carry() {
+        size_t i = pos_;
+        while (i > base_) {
+            i--;
+            if (++out_[i] != 0) {
+                return;
+            }
+        }
+    }
+};
+
+class Range64Decoder {
+public:
+    Range64Decoder(const uint8_t* data, size_t size)
+        : data_(data), size_(size), pos_(0), code_(0),
+          range_(~static_cast<uint64_t>(0)), renorms_(0) {
+        for (int i = 0; i < 8; ++i) {
+            code_ = (code_ << 8) | read_byte();
+        }
+    }
+
+    // Batch decode matching RangeDecoder::decode_symbols: up to `n` literal
+    // symbols into `dst`; a short count means EOF_SYMBOL was consumed.
+    size_t decode_symbols(uint8_t* dst, size_t n, const std::vector<uint32_t>& cumulative,
+                          const SymbolLookup& lut) {
+        const uint32_t* cum = cumulative.data();
+        const uint16_t* slot = lut.slot.data();
+        const uint32_t shift = lut.shift;
+        const uint32_t total = cumulative.back();
+
+        size_t written = 0;
+        while (written < n) {
+            uint64_t r = range_ / total;
+            uint32_t value = static_cast<uint32_t>(code_ / r);
+            if (value >= total) {
+                value = total - 1;
+            }
+
+            uint32_t symbol = slot[value >> shift];
+            while (cum[symbol + 1] <= value) {
+                symbol++;
+            }
+
+            code_ -= r * cum[symbol];
+            range_ = r * (cum[symbol + 1] - cum[symbol]);
+
+            while (range_ < TOP) {
+                code_ = (code_ << 32) | read32();
+                range_ <<= 32;
+                renorms_++;
+            }
+
+            if (symbol == EOF_SYMBOL) {
+                break;
+            }
+            dst[written++] = static_cast<uint8_t>(symbol);
+        }
+        return written;
+    }
+
+    // Renormalization iterations performed so far (one per consumed word).
+    uint64_t renorm_count() const { return renorms_; }
+
+private:
+    static constexpr uint64_t TOP = static_cast<uint64_t>(1) << 32;
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+    uint64_t code_;
+    uint64_t range_;
+    uint64_t renorms_;
+
+    uint32_t read_byte() {
+        if (pos_ < size_) {
+            return static_cast<uint32_t>(data_[pos_++]);
+        }
+        return 0;
+    }
+
+    uint32_t read32() {
+        uint32_t word = read_byte() << 24;
+        word |= read_byte() << 16;
+        word |= read_byte() << 8;
+        word |= read_byte();
+        return word;
+    }
+};
+
+// Whole-buffer front end for the 64-bit coder. Container: "RC64" magic,
+// compact varint table, then the word-renormalized payload. The bitstream
+// is not compatible with RCNC/RCCP, hence the distinct magic.
+std::vector<uint8_t> encode64(const std::vector<uint8_t>& data) {
+    double t0 = codec_core::now_ms();
+    std::vector<uint32_t> freq = build_frequencies_from_data(data);
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
+    double t1 = codec_core::now_ms();
+
+    std::vector<uint8_t> out;
+    const char magic[4] = {'R', 'C', '6', '4'};
+    out.insert(out.end(), magic, magic + 4);
+    codec_core::write_frequencies_compact(out, freq);
+
+    Range64Encoder encoder(out, data.size() + data.size() / 16);
+    encoder.encode_symbols(data.data(), data.size(), cumulative);
+    encoder.encode_symbol(EOF_SYMBOL, cumulative);
+    encoder.finish();
+    if (g_stats_enabled) {
+        stats_add("histogram_ms", t1 - t0);
+        stats_add("encode_ms", codec_core::now_ms() - t1);
+        stats_add("renorms", static_cast<double>(encoder.renorm_count()));
+    }
+
+    return out;
+}
+
+std::vector<uint8_t> decode64(const std::vector<uint8_t>& encoded) {
+    double t0 = codec_core::now_ms();
+    if (encoded.size() < 4 || encoded[0] != 'R' || encoded[1] != 'C' ||
+        encoded[2] != '6' || encoded[3] != '4') {
+        throw std::runtime_error("Invalid 64-bit range-coded stream");
+    }
+    size_t pos = 4;
+    std::vector<uint32_t> freq;
+    if (!codec_core::read_frequencies_compact(encoded, pos, freq, SYMBOL_LIMIT)) {
+        throw std::runtime_error("Invalid 64-bit range-coded stream");
+    }
+    if (freq.size() != SYMBOL_LIMIT) {
+        throw std::runtime_error("Unexpected symbol count in header");
+    }
+    std::vector<uint32_t> cumulative = build_cumulative(freq);
+    SymbolLookup lut = build_symbol_lookup(cumulative);
+    double t1 = codec_core::now_ms();
+    stats_add("setup_ms", t1 - t0);
+
+    std::vector<uint8_t> out;
+    Range64Decoder decoder(encoded.data() + pos, encoded.size() - pos);
+    const size_t CHUNK = 1u << 16;
+    for (;;) {
+        size_t base = out.size();
+        out.resize(base + CHUNK);
+        size_t got = decoder.decode_symbols(out.data() + base, CHUNK, cumulative, lut);
+        out.resize(base + got);
+        if (got < CHUNK) {
+            break;
+        }
+    }
+    if (g_stats_enabled) {
+        stats_add("decode_ms", codec_core::now_ms() - t1);
+        stats_add("renorms", static_cast<double>(decoder.renorm_count()));
+    }
+
+    return out;
+}
+
+// Small-alphabet specialization ("RCSA" container). Genomics-style inputs
+// use a handful of distinct bytes (four DNA bases plus separators), and
+// the generic coder drags a 257-entry cumulative table plus a lookup
+// table through the inner loop for them. Here the coder is templated on
+// the alphabet size: the cumulative bounds live in a
+// std::array<uint32_t, N + 1> (40 bytes for N = 8 — less than one cache
+// line), the symbol search is a binary search whose step count is fixed
+// by N and fully unrolls, and the coder mechanics are the carry-based
+// 64-bit scheme of Range64Encoder, so no collapse guard is needed.
+// A pre-scan picks the narrowest fit: up to 4 distinct bytes skip
+// entropy coding entirely and pack 2 bits per symbol; up to 8 or 16 use
+// the templated coder; anything wider falls back to the generic encode()
+// (the decoder dispatches on the magic, so callers never care).
+//
+// Layout: magic "RCSA", one mode byte (2 = packed, otherwise N), one
+// distinct-count byte, the palette of distinct bytes in ascending order,
+// a varint symbol count, then for the coded modes the distinct scaled
+// frequencies as varints, and the payload. The exact symbol count sits
+// in the header, so the stream carries no EOF symbol.
+
+static const uint32_t SMALL_PACKED_LIMIT = 4;
+static const uint32_t SMALL_CODED_LIMIT = 16;
+
+template <uint32_t N>
+class SmallRangeEncoder {
+public:
+    SmallRangeEncoder(std::vector<uint8_t>& out, const std::array<uint32_t, N + 1>& cumulative,
+                      size_t sizeHint)
+        : out_(out), base_(out.size()), pos_(out.size()), cum_(cumulative),
+          low_(0), range_(~static_cast<uint64_t>(0)) {
+        out_.resize(base_ + sizeHint + 64);
+    }
+
+    // Encodes `n` raw bytes through the palette map `toIndex`. The table
+    // reference is a fixed-size array member, so `cum_[N]` and the bound
+    // loads compile to constant offsets instead of size-dependent loads.
+    void encode_bytes(const uint8_t* src, size_t n, const uint8_t* toIndex) {
+        const uint32_t total = cum_[N];
+        for (size_t i = 0; i < n; i++) {
+            uint32_t symbol = toIndex[src[i]];
+            uint64_t r = range_ / total;
+            uint64_t newLow = low_ + r * cum_[symbol];
+            if (newLow < low_) {
+                propagate_carry();
+            }
+            low_ = newLow;
+            range_ = r * (cum_[symbol + 1] - cum_[symbol]);
+
+            while (range_ < TOP) {
+                emit32(static_cast<uint32_t>(low_ >> 32));
+                low_ <<= 32;
+                range_ <<= 32;
+            }
+        }
+    }
+
+    void finish() {
+        for (int i = 0; i < 2; ++i) {
+            emit32(static_cast<uint32_t>(low_ >> 32));
+            low_ <<= 32;
+        }
+        out_.resize(pos_);
+    }
+
+private:
+    static constexpr uint64_t TOP = static_cast<uint64_t>(1) << 32;
+
+    std::vector<uint8_t>& out_;
+    size_t base_;
+    size_t pos_;
+    const std::array<uint32_t, N + 1>& cum_;
+    uint64_t low_;
+    uint64_t range_;
+
+    void emit32(uint32_t word) {
+        if (pos_ + 4 > out_.size()) {
+            out_.resize(out_.size() + (out_.size() >> 1) + 4096);
+        }
+        uint8_t* p = out_.data() + pos_;
+        p[0] = static_cast<uint8_t>(word >> 24);
+        p[1] = static_cast<uint8_t>(word >> 16);
+        p[2] = static_cast<uint8_t>(word >> 8);
+        p[3] = static_cast<uint8_t>(word);
+        pos_ += 4;
+    }
+
+    void propagate_carry() {
+        size_t i = pos_;
+        while (i > base_) {
+            i--;
+            if (++out_[i] != 0) {
+                return;
+            }
+        }
+    }
+};
+
+template <uint32_t N>
+class SmallRangeDecoder {
+    static_assert((N & (N - 1)) == 0, "unrolled search assumes a power-of-two alphabet");
+
+public:
+    SmallRangeDecoder(const uint8_t* data, size_t size,
+                      const std::array<uint32_t, N + 1>& cumulative)
+        : data_(data), size_(size), pos_(0), code_(0),
+          range_(~static_cast<uint64_t>(0)), cum_(cumulative) {
+        for (int i = 0; i < 8; ++i) {
+            code_ = (code_ << 8) | read_byte();
+        }
+    }
+
+    // Decodes exactly `n` symbols, writing them through the palette so the
+    // caller receives raw bytes. The bound search is log2(N) compares with
+    // a constant trip count, which the compiler unrolls and keeps entirely
+    // inside the array's cache line.
+    void decode_bytes(uint8_t* dst, size_t n, const uint8_t* palette) {
+        const uint32_t total = cum_[N];
+        for (size_t i = 0; i < n; i++) {
+            uint64_t r = range_ / total;
+            uint32_t value = static_cast<uint32_t>(code_ / r);
+            if (value >= total) {
+                value = total - 1;
+            }
+
+            uint32_t symbol = 0;
+            for (uint32_t step = N / 2; step > 0; step >>= 1) {
+                if (cum_[symbol + step] <= value) {
+                    symbol += step;
+                }
+            }
+
+            code_ -= r * cum_[symbol];
+            range_ = r * (cum_[symbol + 1] - cum_[symbol]);
+
+            while (range_ < TOP) {
+                code_ = (code_ << 32) | read32();
+                range_ <<= 32;
+            }
+
+            dst[i] = palette[symbol];
+        }
+    }
+
+private:
+    static constexpr uint64_t TOP = static_cast<uint64_t>(1) << 32;
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+    uint64_t code_;
+    uint64_t range_;
+    const std::array<uint32_t, N + 1>& cum_;
+
+    uint32_t read_byte() {
+        if (pos_ < size_) {
+            return static_cast<uint32_t>(data_[pos_++]);
+        }
+        return 0;
+    }
+
+    uint32_t read32() {
+        uint32_t word = read_byte() << 24;
+        word |= read_byte() << 16;
+        word |= read_byte() << 8;
+        word |= read_byte();
+        return word;
+    }
+};
+
+template <uint32_t N>
+static void encode_small_payload(const std::vector<uint8_t>& data, const uint8_t* toIndex,
+                                 const std::vector<uint32_t>& freq, std::vector<uint8_t>& out) {
+    for (uint32_t f : freq) {
+        codec_core::write_varint(out, f);
+    }
+    std::array<uint32_t, N + 1> cumulative{};
+    for (uint32_t s = 0; s < N; s++) {
+        cumulative[s + 1] = cumulative[s] + (s < freq.size() ? freq[s] : 0);
+    }
+    SmallRangeEncoder<N> encoder(out, cumulative, data.size() / 2);
+    encoder.encode_bytes(data.data(), data.size(), toIndex);
+    encoder.finish();
+}
+
+template <uint32_t N>
+static void decode_small_payload(const std::vector<uint8_t>& encoded, size_t pos,
+                                 const std::vector<uint32_t>& freq, const uint8_t* palette,
+                                 std::vector<uint8_t>& out) {
+    std::array<uint32_t, N + 1> cumulative{};
+    for (uint32_t s = 0; s < N; s++) {
+        cumulative[s + 1] = cumulative[s] + (s < freq.size() ? freq[s] : 0);
+    }
+    if (cumulative[N] == 0) {
+        throw std::runtime_error("Invalid small-alphabet stream");
+    }
+    SmallRangeDecoder<N> decoder(encoded.data() + pos, encoded.size() - pos, cumulative);
+    decoder.decode_bytes(out.data(), out.size(), palette);
+}
+
+std::vector<uint8_t> encode_small(const std::vector<uint8_t>& data) {
+    double t0 = codec_core::now_ms();
+    std::vector<uint32_t> counts(4 * 256, 0);
+    histogram_add(data.data(), data.size(), counts.data());
+    std::vector<uint32_t> byteFreq(257, 0);
+    histogram_reduce(counts.data(), byteFreq);
+
+    uint8_t palette[256];
+    uint8_t toIndex[256] = {0};
+    uint32_t distinct = 0;
+    for (uint32_t b = 0; b < 256; b++) {
+        if (byteFreq[b] != 0) {
+            if (distinct < 256) {
+                palette[distinct] = static_cast<uint8_t>(b);
+                toIndex[b] = static_cast<uint8_t>(distinct);
+            }
+            distinct++;
+        }
+    }
+    stats_add("distinct", static_cast<double>(distinct));
+
+    if (distinct > SMALL_CODED_LIMIT) {
+        // Alphabet too wide for the specialized tables; the generic
+        // container is still the right answer for this input.
+        stats_add("small_mode", 0);
+        return encode(data, false);
+    }
+
+    std::vector<uint8_t> out;
+    const char magic[4] = {'R', 'C', 'S', 'A'};
+    out.insert(out.end(), magic, magic + 4);
+
+    if (distinct <= SMALL_PACKED_LIMIT) {
+        // 2-bit packed fast path: with at most four distinct bytes every
+        // symbol is an index into the palette, no entropy coder involved.
+        out.push_back(2);
+        out.push_back(static_cast<uint8_t>(distinct));
+        out.insert(out.end(), palette, palette + distinct);
+        codec_core::write_varint(out, data.size());
+        out.reserve(out.size() + (data.size() + 3) / 4);
+        uint8_t packed = 0;
+        for (size_t i = 0; i < data.size(); i++) {
+            packed |= static_cast<uint8_t>(toIndex[data[i]] << ((i & 3) * 2));
+            if ((i & 3) == 3) {
+                out.push_back(packed);
+                packed = 0;
+            }
+        }
+        if ((data.size() & 3) != 0) {
+            out.push_back(packed);
+        }
+        stats_add("small_mode", 2);
+        stats_add("encode_ms", codec_core::now_ms() - t0);
+        return out;
+    }
+
+    uint32_t width = distinct <= 8 ? 8 : 16;
+    out.push_back(static_cast<uint8_t>(width));
+    out.push_back(static_cast<uint8_t>(distinct));
+    out.insert(out.end(), palette, palette + distinct);
+    codec_core::write_varint(out, data.size());
+
+    std::vector<uint32_t> freq(distinct, 0);
+    for (uint32_t s = 0; s < distinct; s++) {
+        freq[s] = byteFreq[palette[s]];
+    }
+    codec_core::scale_frequencies(freq, MAX_TOTAL);
+
+    if (width == 8) {
+        encode_small_payload<8>(data, toIndex, freq, out);
+    } else {
+        encode_small_payload<16>(data, toIndex, freq, out);
+    }
+    stats_add("small_mode", static_cast<double>(width));
+    stats_add("encode_ms", codec_core::now_ms() - t0);
+    return out;
+}
+
+std::vector<uint8_t> decode_small(const std::vector<uint8_t>& encoded) {
+    double t0 = codec_core::now_ms();
+    if (encoded.size() < 7 || encoded[0] != 'R' || encoded[1] != 'C' ||
+        encoded[2] != 'S' || encoded[3] != 'A') {
+        throw std::runtime_error("Invalid small-alphabet stream");
+    }
+    uint32_t mode = encoded[4];
+    uint32_t distinct = encoded[5];
+    size_t pos = 6;
+    // distinct == 0 is legal only for an empty input; the payload checks
+    // below reject it whenever rawSize is non-zero.
+    if (distinct > SMALL_CODED_LIMIT || pos + distinct > encoded.size()) {
+        throw std::runtime_error("Invalid small-alphabet stream");
+    }
+    uint8_t palette[SMALL_CODED_LIMIT] = {0};
+    std::memcpy(palette, encoded.data() + pos, distinct);
+    pos += distinct;
+    uint64_t rawSize = 0;
+    if (!codec_core::read_varint(encoded, pos, rawSize)) {
+        throw std::runtime_error("Invalid small-alphabet stream");
+    }
+
+    std::vector<uint8_t> out(static_cast<size_t>(rawSize));
+    if (mode == 2) {
+        if (pos + (rawSize + 3) / 4 > encoded.size()) {
+            throw std::runtime_error("Invalid small-alphabet stream");
+        }
+        for (size_t i = 0; i < out.size(); i++) {
+            uint32_t index = (encoded[pos + i / 4] >> ((i & 3) * 2)) & 3u;
+            if (index >= distinct) {
+                throw std::runtime_error("Invalid small-alphabet stream");
+            }
+            out[i] = palette[index];
+        }
+        stats_add("decode_ms", codec_core::now_ms() - t0);
+        return out;
+    }
+
+    if (mode != 8 && mode != 16) {
+        throw std::runtime_error("Invalid small-alphabet stream");
+    }
+    std::vector<uint32_t> freq(distinct, 0);
+    for (uint32_t s = 0; s < distinct; s++) {
+        uint64_t v = 0;
+        if (!codec_core::read_varint(encoded, pos, v)) {
+            throw std::runtime_error("Invalid small-alphabet stream");
+        }
+        freq[s] = static_cast<uint32_t>(v);
+    }
+    if (mode == 8) {
+        decode_small_payload<8>(encoded, pos, freq, palette, out);
+    } else {
+        decode_small_payload<16>(encoded, pos, freq, palette, out);
+    }
+    stats_add("decode_ms", codec_core::now_ms() - t0);
+    return out;
+}
+
+// Streaming front end: the whole-buffer encode()/decode() above need the
+// entire file in memory, which rules out large archives. The stream
+// variants work through fixed-size chunks, each carried as a complete
+// range-coded payload behind a small record header, so peak memory is
+// O(chunk size) no matter how big the input is. Container layout:
+// magic "RCST", u32 chunk size, then (u32 rawSize, u32 compSize, payload)
+// records terminated by a 0/0 record.
+
+static const uint32_t DEFAULT_CHUNK_SIZE = 1u << 20;
+
+void encode_stream(std::istream& in, std::ostream& out, uint32_t chunkSize = DEFAULT_CHUNK_SIZE) {
+    StatsSuspend statsSuspend;
+    if (chunkSize == 0) {
+        throw std::runtime_error("Chunk size must be positive");
+    }
+    const char magic[4] = {'R', 'C', 'S', 'T'};
+    out.write(magic, 4);
+    write_u32(out, chunkSize);
+
+    std::vector<uint8_t> chunk;
+    for (;;) {
+        chunk.resize(chunkSize);
+        in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunkSize));
+        std::streamsize got = in.gcount();
+        if (got <= 0) {
+            break;
+        }
+        chunk.resize(static_cast<size_t>(got));
+        std::vector<uint8_t> payload = encode(chunk);
+        write_u32(out, static_cast<uint32_t>(chunk.size()));
+        write_u32(out, static_cast<uint32_t>(payload.size()));
+        out.write(reinterpret_cast<const char*>(payload.data()),
+                  static_cast<std::streamsize>(payload.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write encoded chunk");
+        }
+        if (static_cast<uint32_t>(got) < chunkSize) {
+            break;
+        }
+    }
+    write_u32(out, 0);
+    write_u32(out, 0);
+    if (!out) {
+        throw std::runtime_error("Failed to write stream trailer");
+    }
+}
+
+void decode_stream(std::istream& in, std::ostream& out) {
+    StatsSuspend statsSuspend;
+    char magic[4];
+    in.read(magic, 4);
+    if (in.gcount() != 4 || magic[0] != 'R' || magic[1] != 'C' || magic[2] != 'S' || magic[3] != 'T') {
+        throw std::runtime_error("Invalid range-coded stream container");
+    }
+    uint32_t chunkSize = 0;
+    if (!read_u32(in, chunkSize) || chunkSize == 0) {
+        throw std::runtime_error("Invalid chunk size in stream header");
+    }
+
+    std::vector<uint8_t> payload;
+    for (;;) {
+        uint32_t rawSize = 0;
+        uint32_t compSize = 0;
+        if (!read_u32(in, rawSize) || !read_u32(in, compSize)) {
+            throw std::runtime_error("Truncated chunk record");
+        }
+        if (rawSize == 0 && compSize == 0) {
+            break;
+        }
+        if (rawSize > chunkSize || compSize == 0) {
+            throw std::runtime_error("Invalid chunk record");
+        }
+        payload.resize(compSize);
+        in.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(compSize));
+        if (in.gcount() != static_cast<std::streamsize>(compSize)) {
+            throw std::runtime_error("Truncated chunk payload");
+        }
+        std::vector<uint8_t> decoded = decode(payload);
+        if (decoded.size() != rawSize) {
+            throw std::runtime_error("Chunk size mismatch after decode");
+        }
+        out.write(reinterpret_cast<const char*>(decoded.data()),
+                  static_cast<std::streamsize>(decoded.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write decoded chunk");
+        }
+    }
+}
+
 } // namespace range_coder
 
+// rANS (range asymmetric numeral system) engine: same model machinery as
+// the range coder above, but the coder state is a plain integer that is
+// pushed/popped with multiplies instead of the range coder's dependent
+// low/high updates. Two interleaved states hide the latency of each
+// other's renormalization, which is where the decode throughput comes
+// from. Layout follows the classic byte-wise rANS: encode walks the input
+// backwards, decode walks the output forwards.
+namespace rans {
+
+static const uint32_t SCALE_BITS = 14;
+static const uint32_t SCALE_TOTAL = 1u << SCALE_BITS;
+static const uint32_t RANS_L = 1u << 23;
+
+// Scales a raw 256-entry histogram so it sums to exactly SCALE_TOTAL while
+// every symbol present in the input keeps a nonzero slot.
+static std::vector<uint32_t> normalize_frequencies(const std::vector<uint32_t>& hist) {
+    std::vector<uint32_t> freq(256, 0);
+    uint64_t total = 0;
+    for (uint32_t h : hist) {
+        total += h;
+    }
+    if (total == 0) {
+        freq[0] = SCALE_TOTAL;
+        return freq;
+    }
+    uint64_t sum = 0;
+    uint32_t largest = 0;
+    for (uint32_t s = 0; s < 256; s++) {
+        if (hist[s] == 0) {
+            continue;
+        }
+        uint64_t scaled = static_cast<uint64_t>(hist[s]) * SCALE_TOTAL / total;
+        if (scaled == 0) {
+            scaled = 1;
+        }
+        freq[s] = static_cast<uint32_t>(scaled);
+        sum += scaled;
+        if (freq[s] > freq[largest]) {
+            largest = s;
+        }
+    }
+    // Push the rounding drift into the most frequent symbol; if that would
+    // drive it to zero, steal the remainder from other symbols first.
+    while (sum > SCALE_TOTAL) {
+        uint64_t excess = sum - SCALE_TOTAL;
+        uint32_t take = freq[largest] > 1 ? static_cast<uint32_t>(std::min<uint64_t>(excess, freq[largest] - 1)) : 0;
+        if (take == 0) {
+            for (uint32_t s = 0; s < 256 && sum > SCALE_TOTAL; s++) {
+                while (freq[s] > 1 && sum > SCALE_TOTAL) {
+                    freq[s]--;
+                    sum--;
+                }
+            }
+            break;
+        }
+        freq[largest] -= take;
+        sum -= take;
+    }
+    if (sum < SCALE_TOTAL) {
+        freq[largest] += static_cast<uint32_t>(SCALE_TOTAL - sum);
+    }
+    return freq;
+}
+
+std::vector<uint8_t> encode(const std::vector<uint8_t>& data) {
+    std::vector<uint32_t> hist(256, 0);
+    {
+        std::vector<uint32_t> counts(4 * 256, 0);
+        codec_core::histogram_add(data.data(), data.size(), counts.data());
+        for (uint32_t s = 0; s < 256; s++) {
+            hist[s] = counts[s] + counts[s + 256] + counts[s + 512] + counts[s + 768];
+        }
+    }
+    std::vector<uint32_t> freq = normalize_frequencies(hist);
+    std::vector<uint32_t> cum(257, 0);
+    for (uint32_t s = 0; s < 256; s++) {
+        cum[s + 1] = cum[s] + freq[s];
+    }
+
+    std::vector<uint8_t> out;
+    const char magic[4] = {'R', 'A', 'N', 'S'};
+    out.insert(out.end(), magic, magic + 4);
+    codec_core::write_u32_le(out, 256);
+    for (uint32_t s = 0; s < 256; s++) {
+        codec_core::write_u32_le(out, freq[s]);
+    }
+    codec_core::write_u32_le(out, static_cast<uint32_t>(data.size()));
+
+    // Encode runs backwards; bytes come out back to front, so build the
+    // payload from the end of a scratch buffer. Renormalization emits at
+    // most two bytes per symbol at these parameters.
+    std::vector<uint8_t> payload(data.size() * 2 + 16);
+    uint8_t* begin = payload.data();
+    uint8_t* ptr = begin + payload.size();
+
+    uint32_t x[2] = {RANS_L, RANS_L};
+    uint64_t renorms = 0;
+    for (size_t i = data.size(); i-- > 0;) {
+        uint8_t s = data[i];
+        uint32_t f = freq[s];
+        uint32_t& st = x[i & 1];
+        uint32_t xMax = ((RANS_L >> SCALE_BITS) << 8) * f;
+        while (st >= xMax) {
+            *--ptr = static_cast<uint8_t>(st & 0xFF);
+            st >>= 8;
+            renorms++;
+        }
+        st = ((st / f) << SCALE_BITS) + (st % f) + cum[s];
+    }
+    range_coder::stats_add("renorms", static_cast<double>(renorms));
+    // Flush so that decode reads state 0 first, then state 1.
+    for (int k = 1; k >= 0; k--) {
+        ptr -= 4;
+        ptr[0] = static_cast<uint8_t>(x[k] & 0xFF);
+        ptr[1] = static_cast<uint8_t>((x[k] >> 8) & 0xFF);
+        ptr[2] = static_cast<uint8_t>((x[k] >> 16) & 0xFF);
+        ptr[3] = static_cast<uint8_t>((x[k] >> 24) & 0xFF);
+    }
+
+    out.insert(out.end(), ptr, begin + payload.size());
+    return out;
+}
+
+std::vector<uint8_t> decode(const std::vector<uint8_t>& encoded) {
+    size_t pos = 0;
+    if (encoded.size() < 4 || encoded[0] != 'R' || encoded[1] != 'A' || encoded[2] != 'N' || encoded[3] != 'S') {
+        throw std::runtime_error("Invalid rANS stream");
+    }
+    pos = 4;
+    uint32_t count = 0;
+    if (!codec_core::read_u32_le(encoded, pos, count) || count != 256) {
+        throw std::runtime_error("Unexpected symbol count in rANS header");
+    }
+    std::vector<uint32_t> freq(256, 0);
+    for (uint32_t s = 0; s < 256; s++) {
+        if (!codec_core::read_u32_le(encoded, pos, freq[s])) {
+            throw std::runtime_error("Truncated rANS header");
+        }
+    }
+    uint32_t rawSize = 0;
+    if (!codec_core::read_u32_le(encoded, pos, rawSize)) {
+        throw std::runtime_error("Truncated rANS header");
+    }
+
+    std::vector<uint32_t> cum(257, 0);
+    for (uint32_t s = 0; s < 256; s++) {
+        cum[s + 1] = cum[s] + freq[s];
+    }
+    if (cum[256] != SCALE_TOTAL) {
+        throw std::runtime_error("Invalid rANS frequency table");
+    }
+    // Slot -> symbol table: one byte per slot, 16 KiB, a single dependent
+    // load per decoded symbol.
+    std::vector<uint8_t> slots(SCALE_TOTAL);
+    for (uint32_t s = 0; s < 256; s++) {
+        for (uint32_t v = cum[s]; v < cum[s + 1]; v++) {
+            slots[v] = static_cast<uint8_t>(s);
+        }
+    }
+
+    std::vector<uint8_t> out(rawSize);
+    if (rawSize == 0) {
+        return out;
+    }
+    if (encoded.size() - pos < 8) {
+        throw std::runtime_error("Truncated rANS stream");
+    }
+    const uint8_t* ptr = encoded.data() + pos;
+    const uint8_t* end = encoded.data() + encoded.size();
+    uint32_t x[2];
+    for (int k = 0; k < 2; k++) {
+        x[k] = static_cast<uint32_t>(ptr[0]) | (static_cast<uint32_t>(ptr[1]) << 8) |
+               (static_cast<uint32_t>(ptr[2]) << 16) | (static_cast<uint32_t>(ptr[3]) << 24);
+        ptr += 4;
+    }
+
+    uint64_t renorms = 0;
+    for (size_t i = 0; i < rawSize; i++) {
+        uint32_t& st = x[i & 1];
+        uint32_t slot = st & (SCALE_TOTAL - 1);
+        uint8_t s = slots[slot];
+        out[i] = s;
+        st = freq[s] * (st >> SCALE_BITS) + slot - cum[s];
+        while (st < RANS_L) {
+            st = (st << 8) | (ptr < end ? *ptr++ : 0);
+            renorms++;
+        }
+    }
+    range_coder::stats_add("renorms", static_cast<double>(renorms));
+    return out;
+}
+
+} // namespace rans
+
 static std::vector<uint8_t> read_file(const std::string& path) {
     std::ifstream in(path, std::ios::binary);
     if (!in) {
@@ -293,6 +1303,56 @@ static void write_file(const std::string& path, const std::vector<uint8_t>& data
     }
 }
 
+// Batch mode: every "input output" pair from the manifest becomes one
+// whole-file task on a work-stealing pool. The range containers here are
+// sequential, so files are not split into blocks; work stealing alone
+// keeps the cores busy across a mixed-size manifest. An input that makes
+// the carryless coder's interval collapse is retried with the 64-bit wide
+// coder (decode dispatches on the "RC64" magic, so the mix is harmless);
+// any other failure is reported and counted instead of aborting the batch.
+static bool encode_many(const std::string& manifestPath, unsigned threadCount) {
+    std::vector<codec_core::ManifestEntry> entries;
+    if (!codec_core::read_manifest(manifestPath, entries)) {
+        throw std::runtime_error("Cannot read manifest file: " + manifestPath);
+    }
+
+    std::atomic<size_t> failures(0);
+    std::atomic<size_t> wideFallbacks(0);
+    unsigned poolThreads = 0;
+    {
+        // g_stats is not thread-safe; keep it quiet for the parallel phase.
+        bool savedStats = range_coder::g_stats_enabled;
+        range_coder::g_stats_enabled = false;
+        codec_core::WorkStealingPool pool(threadCount);
+        poolThreads = pool.size();
+        for (const codec_core::ManifestEntry& entry : entries) {
+            pool.submit([entry, &failures, &wideFallbacks] {
+                try {
+                    std::vector<uint8_t> data = read_file(entry.input);
+                    std::vector<uint8_t> encoded;
+                    try {
+                        encoded = range_coder::encode(data, false);
+                    } catch (const std::runtime_error&) {
+                        encoded = range_coder::encode64(data);
+                        wideFallbacks.fetch_add(1);
+                    }
+                    write_file(entry.output, encoded);
+                } catch (const std::exception& ex) {
+                    std::cerr << "Error encoding " << entry.input << ": " << ex.what() << "\n";
+                    failures.fetch_add(1);
+                }
+            });
+        }
+        pool.wait_idle();
+        range_coder::g_stats_enabled = savedStats;
+    }
+    range_coder::stats_add("files", static_cast<double>(entries.size()));
+    range_coder::stats_add("failures", static_cast<double>(failures.load()));
+    range_coder::stats_add("wide_fallbacks", static_cast<double>(wideFallbacks.load()));
+    range_coder::stats_add("pool_threads", static_cast<double>(poolThreads));
+    return failures.load() == 0;
+}
+
 static void run_benchmark(std::size_t size_bytes, int iterations) {
     std::vector<uint8_t> data(size_bytes);
     for (std::size_t i = 0; i < size_bytes; ++i) {
@@ -332,43 +1392,136 @@ static void run_benchmark(std::size_t size_bytes, int iterations) {
               << (total_mb / dec_dur.count()) << " MiB/s" << std::endl;
 }
 
+#ifndef ENCODING_NO_MAIN
 int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stats") {
+            range_coder::g_stats_enabled = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    std::string mode = args.empty() ? std::string() : args[0];
+    std::string inputPath = args.size() > 1 ? args[1] : std::string();
+    std::string outputPath = args.size() > 2 ? args[2] : std::string();
+    int rc = 0;
+    double t0 = codec_core::now_ms();
+
     try {
-        if (argc < 2) {
-            std::cerr << "Usage: " << argv[0] << " encode input output\n";
-            std::cerr << "       " << argv[0] << " decode input output\n";
+        if (args.empty()) {
+            std::cerr << "Usage: " << argv[0] << " encode|encode-compact|encode-wide|encode-small input output [--stats]\n";
+            std::cerr << "       " << argv[0] << " encode-stream input output [chunk_size] [--stats]\n";
+            std::cerr << "       " << argv[0] << " encode-rans input output [--stats]\n";
+            std::cerr << "       " << argv[0] << " decode input output [--stats]\n";
+            std::cerr << "       " << argv[0] << " encode-many manifest [threads] [--stats]\n";
             std::cerr << "       " << argv[0] << " bench [size_bytes] [iterations]\n";
             return 1;
         }
-        std::string mode = argv[1];
-        if (mode == "encode") {
-            if (argc != 4) {
-                std::cerr << "Usage: " << argv[0] << " encode input output\n";
+        if (mode == "encode" || mode == "encode-compact") {
+            if (args.size() != 3) {
+                std::cerr << "Usage: " << argv[0] << " " << mode << " input output [--stats]\n";
                 return 1;
             }
-            std::string inputPath = argv[2];
-            std::string outputPath = argv[3];
             std::vector<uint8_t> data = read_file(inputPath);
-            std::vector<uint8_t> encoded = range_coder::encode(data);
+            std::vector<uint8_t> encoded = range_coder::encode(data, mode == "encode-compact");
+            write_file(outputPath, encoded);
+        } else if (mode == "encode-wide") {
+            if (args.size() != 3) {
+                std::cerr << "Usage: " << argv[0] << " encode-wide input output [--stats]\n";
+                return 1;
+            }
+            std::vector<uint8_t> data = read_file(inputPath);
+            std::vector<uint8_t> encoded = range_coder::encode64(data);
+            write_file(outputPath, encoded);
+        } else if (mode == "encode-small") {
+            if (args.size() != 3) {
+                std::cerr << "Usage: " << argv[0] << " encode-small input output [--stats]\n";
+                return 1;
+            }
+            std::vector<uint8_t> data = read_file(inputPath);
+            std::vector<uint8_t> encoded = range_coder::encode_small(data);
             write_file(outputPath, encoded);
         } else if (mode == "decode") {
-            if (argc != 4) {
-                std::cerr << "Usage: " << argv[0] << " decode input output\n";
+            if (args.size() != 3) {
+                std::cerr << "Usage: " << argv[0] << " decode input output [--stats]\n";
+                return 1;
+            }
+            // Chunked containers are decoded through the streaming path so
+            // memory stays bounded; whole-buffer formats keep the old path.
+            std::ifstream probe(inputPath, std::ios::binary);
+            if (!probe) {
+                throw std::runtime_error("Cannot open input file: " + inputPath);
+            }
+            char magic[4] = {0, 0, 0, 0};
+            probe.read(magic, 4);
+            probe.close();
+            if (magic[0] == 'R' && magic[1] == 'C' && magic[2] == 'S' && magic[3] == 'T') {
+                std::ifstream in(inputPath, std::ios::binary);
+                std::ofstream out(outputPath, std::ios::binary);
+                if (!out) {
+                    throw std::runtime_error("Cannot open output file: " + outputPath);
+                }
+                range_coder::decode_stream(in, out);
+            } else {
+                std::vector<uint8_t> encoded = read_file(inputPath);
+                std::vector<uint8_t> decoded;
+                if (encoded.size() >= 4 && encoded[0] == 'R' && encoded[1] == 'A' && encoded[2] == 'N' && encoded[3] == 'S') {
+                    decoded = rans::decode(encoded);
+                } else if (encoded.size() >= 4 && encoded[0] == 'R' && encoded[1] == 'C' && encoded[2] == '6' && encoded[3] == '4') {
+                    decoded = range_coder::decode64(encoded);
+                } else if (encoded.size() >= 4 && encoded[0] == 'R' && encoded[1] == 'C' && encoded[2] == 'S' && encoded[3] == 'A') {
+                    decoded = range_coder::decode_small(encoded);
+                } else {
+                    decoded = range_coder::decode(encoded);
+                }
+                write_file(outputPath, decoded);
+            }
+        } else if (mode == "encode-stream") {
+            if (args.size() != 3 && args.size() != 4) {
+                std::cerr << "Usage: " << argv[0] << " encode-stream input output [chunk_size] [--stats]\n";
                 return 1;
             }
-            std::string inputPath = argv[2];
-            std::string outputPath = argv[3];
-            std::vector<uint8_t> encoded = read_file(inputPath);
-            std::vector<uint8_t> decoded = range_coder::decode(encoded);
-            write_file(outputPath, decoded);
+            uint32_t chunkSize = range_coder::DEFAULT_CHUNK_SIZE;
+            if (args.size() == 4) {
+                chunkSize = static_cast<uint32_t>(std::stoul(args[3]));
+            }
+            std::ifstream in(inputPath, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Cannot open input file: " + inputPath);
+            }
+            std::ofstream out(outputPath, std::ios::binary);
+            if (!out) {
+                throw std::runtime_error("Cannot open output file: " + outputPath);
+            }
+            range_coder::encode_stream(in, out, chunkSize);
+        } else if (mode == "encode-rans") {
+            if (args.size() != 3) {
+                std::cerr << "Usage: " << argv[0] << " encode-rans input output [--stats]\n";
+                return 1;
+            }
+            std::vector<uint8_t> data = read_file(inputPath);
+            std::vector<uint8_t> encoded = rans::encode(data);
+            write_file(outputPath, encoded);
+        } else if (mode == "encode-many") {
+            if (args.size() != 2 && args.size() != 3) {
+                std::cerr << "Usage: " << argv[0] << " encode-many manifest [threads] [--stats]\n";
+                return 1;
+            }
+            unsigned threads = args.size() == 3 ? static_cast<unsigned>(std::stoul(args[2])) : 0;
+            if (!encode_many(inputPath, threads)) {
+                rc = 1;
+            }
         } else if (mode == "bench") {
             std::size_t size_bytes = 1u << 20; // 1 MiB
             int iterations = 20;
-            if (argc >= 3) {
-                size_bytes = static_cast<std::size_t>(std::stoul(argv[2]));
+            if (args.size() >= 2) {
+                size_bytes = static_cast<std::size_t>(std::stoul(args[1]));
             }
-            if (argc >= 4) {
-                iterations = std::stoi(argv[3]);
+            if (args.size() >= 3) {
+                iterations = std::stoi(args[2]);
             }
             run_benchmark(size_bytes, iterations);
         } else {
@@ -377,8 +1530,23 @@ int main(int argc, char** argv) {
         }
     } catch (const std::exception& ex) {
         std::cerr << "Error: " << ex.what() << "\n";
-        return 1;
+        rc = 1;
+    }
+
+    if (range_coder::g_stats_enabled && mode != "bench") {
+        double totalMs = codec_core::now_ms() - t0;
+        uint64_t bytesIn = codec_core::file_size(inputPath);
+        uint64_t bytesOut = codec_core::file_size(outputPath);
+        uint64_t symbols = mode == "decode" ? bytesOut : bytesIn;
+        std::cerr << "STATS tool=range mode=" << mode
+                  << " ok=" << (rc == 0 ? 1 : 0)
+                  << " bytes_in=" << bytesIn
+                  << " bytes_out=" << bytesOut
+                  << " total_ms=" << totalMs
+                  << " symbols_per_s=" << (totalMs > 0.0 ? static_cast<double>(symbols) / (totalMs / 1000.0) : 0.0)
+                  << range_coder::g_stats.str() << "\n";
     }
 
-    return 0;
+    return rc;
 }
+#endif // ENCODING_NO_MAIN